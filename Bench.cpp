@@ -0,0 +1,824 @@
+#include <iostream>
+#include <cassert>
+#include <vector>
+#include <array>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <filesystem>
+
+#include <glm/glm.hpp>
+
+#include "Common.h"
+#include "Handle.h"
+#include "PipelineFactory.h"
+#include "Texture.h"
+#include "HostAllocator.h"
+#include "Offscreen.h"
+#include "Mesh.h"
+#include "Occlusion.h"
+
+//!< Offscreen render target of every scene
+static const uint32_t Width = 640;
+static const uint32_t Height = 360;
+
+struct BenchScene
+{
+	const char* Name;
+	PipelineState State;
+	uint32_t InstanceCount;
+	bool IsMesh = false;		//!< LOD chain mesh instead of the triangle
+	bool IsLOD = false;			//!< Level per instance, level 0 for all otherwise
+	//!< Occluders (the nearest layer) go through a depth prepass, the instances are culled with the previous frame's hierarchical depth or occlusion queries
+	enum class OCCLUSION : uint8_t { NONE, HIZ, QUERY };
+	OCCLUSION Occlusion = OCCLUSION::NONE;
+};
+
+struct BenchResult
+{
+	std::string Name;
+	uint32_t Frames = 0;
+	//!< Frame times are medians over the measured frames, a descheduled frame on a CPU rasterizer does not move them
+	double FrameMS = 0.0;		//!< Wall time from recording until the fence signaled
+	double CPUFrameMS = 0.0;	//!< Recording and submission only
+	double GPUFrameMS = 0.0;	//!< Timestamps around the frame, negative when the queue has no timestamp support
+	double AllocationsPerFrame = 0.0;
+	double AllocatedBytesPerFrame = 0.0;
+	double TrianglesPerFrame = 0.0;
+	double FragmentsPerFrame = -1.0;	//!< Fragment shader invocations, negative without pipeline statistics queries
+	double ImageMismatch = 0.0;	//!< Ratio of pixels outside of the channel tolerance
+	bool IsNewGolden = false;
+	std::vector<std::string> Failures;
+	std::vector<std::string> Unverified;	//!< Nothing to compare with (no golden image or baseline, or a baseline of another device)
+};
+
+static bool WritePPM(const std::string& Path, const uint32_t W, const uint32_t H, const std::vector<uint8_t>& RGB)
+{
+	std::ofstream Out(Path.c_str(), std::ios::out | std::ios::binary);
+	if (Out.fail()) { return false; }
+	Out << "P6\n" << W << " " << H << "\n255\n";
+	Out.write(reinterpret_cast<const char*>(RGB.data()), RGB.size());
+	return !Out.fail();
+}
+static bool LoadPPM(const std::string& Path, uint32_t& W, uint32_t& H, std::vector<uint8_t>& RGB)
+{
+	std::ifstream In(Path.c_str(), std::ios::in | std::ios::binary);
+	if (In.fail()) { return false; }
+	std::string Magic;
+	uint32_t Max = 0;
+	In >> Magic >> W >> H >> Max;
+	if ("P6" != Magic || 255 != Max) { return false; }
+	In.get();
+	RGB.resize(static_cast<size_t>(W) * H * 3);
+	In.read(reinterpret_cast<char*>(RGB.data()), RGB.size());
+	return !In.fail();
+}
+
+//!< Only understands the flat layout written by WriteJSON, looks up Key inside the object of the named scene
+static bool FindBaseline(const std::string& Json, const std::string& Scene, const std::string& Key, double& Value)
+{
+	const auto Begin = Json.find("\"Name\" : \"" + Scene + "\"");
+	if (std::string::npos == Begin) { return false; }
+	const auto End = Json.find('}', Begin);
+	const auto Pos = Json.find("\"" + Key + "\" : ", Begin);
+	if (std::string::npos == Pos || Pos > End) { return false; }
+	Value = strtod(Json.c_str() + Pos + Key.size() + 5, nullptr);
+	return true;
+}
+
+//!< Device the baseline was recorded on
+static std::string FindBaselineDevice(const std::string& Json)
+{
+	const std::string Key = "\"Device\" : \"";
+	const auto Begin = Json.find(Key);
+	if (std::string::npos == Begin) { return std::string(); }
+	const auto End = Json.find('"', Begin + Key.size());
+	return std::string::npos == End ? std::string() : Json.substr(Begin + Key.size(), End - Begin - Key.size());
+}
+
+static double GetMedian(std::vector<double> Samples)
+{
+	if (Samples.empty()) { return 0.0; }
+	const auto Mid = Samples.begin() + Samples.size() / 2;
+	std::nth_element(Samples.begin(), Mid, Samples.end());
+	return *Mid;
+}
+
+static void WriteJSON(std::ostream& Out, const std::string& Device, const std::vector<BenchResult>& Results)
+{
+	Out << "{" << std::endl;
+	Out << "\t\"Device\" : \"" << Device << "\"," << std::endl;
+	Out << "\t\"Scenes\" : [" << std::endl;
+	for (size_t i = 0; i < Results.size(); ++i) {
+		const auto& R = Results[i];
+		Out << "\t\t{ ";
+		Out << "\"Name\" : \"" << R.Name << "\", ";
+		Out << "\"Frames\" : " << R.Frames << ", ";
+		Out << "\"FrameMS\" : " << R.FrameMS << ", ";
+		Out << "\"CPUFrameMS\" : " << R.CPUFrameMS << ", ";
+		Out << "\"GPUFrameMS\" : " << R.GPUFrameMS << ", ";
+		Out << "\"AllocationsPerFrame\" : " << R.AllocationsPerFrame << ", ";
+		Out << "\"AllocatedBytesPerFrame\" : " << R.AllocatedBytesPerFrame << ", ";
+		Out << "\"TrianglesPerFrame\" : " << R.TrianglesPerFrame << ", ";
+		Out << "\"FragmentsPerFrame\" : " << R.FragmentsPerFrame << ", ";
+		Out << "\"ImageMismatch\" : " << R.ImageMismatch << ", ";
+		Out << "\"Passed\" : " << (R.Failures.empty() ? "true" : "false") << ", ";
+		Out << "\"Verified\" : " << (R.Unverified.empty() ? "true" : "false");
+		Out << " }" << (i + 1 < Results.size() ? "," : "") << std::endl;
+	}
+	Out << "\t]" << std::endl;
+	Out << "}" << std::endl;
+}
+
+//!< Runs a fixed set of scenes offscreen and fails (non zero exit) when a scene renders differently from its golden image or got slower than the baseline
+int main(int argc, char* argv[])
+{
+	//!< Options
+	std::string DeviceFilter;				//!< Substring of the device name, e.g. "llvmpipe" to force lavapipe
+	std::string BenchDir = "Bench";			//!< Holds Baseline.json and Golden/*.ppm
+	std::string OutputDir = "Bench/Output";
+	uint32_t WarmupFrames = 16;
+	uint32_t MeasureFrames = 128;
+	double Tolerance = 1.25;				//!< Allowed slowdown against the baseline
+	double SlackMS = 0.5;					//!< Allowed absolute slowdown of the frame times on top of Tolerance
+	uint32_t ChannelTolerance = 8;			//!< Allowed per channel difference against the golden image
+	double MismatchTolerance = 0.001;		//!< Allowed ratio of pixels outside of ChannelTolerance
+	auto IsUpdate = false;					//!< Accept this run as the new baseline and golden images
+	auto IsStrict = false;					//!< Missing references fail instead of leaving the scene unverified
+	for (auto i = 1; i < argc; ++i) {
+		const std::string Arg = argv[i];
+		const auto HasValue = i + 1 < argc;
+		if ("--device" == Arg && HasValue) { DeviceFilter = argv[++i]; }
+		else if ("--bench-dir" == Arg && HasValue) { BenchDir = argv[++i]; }
+		else if ("--output-dir" == Arg && HasValue) { OutputDir = argv[++i]; }
+		else if ("--warmup" == Arg && HasValue) { WarmupFrames = (std::max)(0, std::atoi(argv[++i])); }
+		else if ("--frames" == Arg && HasValue) { MeasureFrames = (std::max)(1, std::atoi(argv[++i])); }
+		else if ("--tolerance" == Arg && HasValue) { Tolerance = std::atof(argv[++i]); }
+		else if ("--slack-ms" == Arg && HasValue) { SlackMS = (std::max)(0.0, std::atof(argv[++i])); }
+		else if ("--update" == Arg) { IsUpdate = true; }
+		else if ("--strict" == Arg) { IsStrict = true; }
+		else { std::cerr << "Unknown option : " << Arg << std::endl; return 2; }
+	}
+	const auto GoldenDir = BenchDir + "/Golden";
+	const auto BaselinePath = BenchDir + "/Baseline.json";
+	std::filesystem::create_directories(OutputDir);
+
+	//!< Every host allocation of the driver goes through here from now on
+	CountingAllocator Allocator;
+	InstalledAllocationCallbacks = Allocator.GetCallbacks();
+
+	//!< Instance (no surface, everything is rendered offscreen)
+	VkInstance Instance;
+	{
+		uint32_t APIVersion;
+		vkEnumerateInstanceVersion(&APIVersion);
+		const VkApplicationInfo AI = {
+			VK_STRUCTURE_TYPE_APPLICATION_INFO,
+			nullptr,
+			"Bench", 0,
+			"EngineName", 0,
+			APIVersion
+		};
+		const VkInstanceCreateInfo ICI = {
+			VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+			nullptr,
+			0,
+			&AI,
+			0, nullptr,
+			0, nullptr
+		};
+		VERIFY_SUCCEEDED(vkCreateInstance(&ICI, GetAllocationCallbacks(), &Instance));
+	}
+
+	//!< Physical device
+	VkPhysicalDevice PhysicalDevice = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties PDP;
+	{
+		uint32_t Count = 0;
+		VERIFY_SUCCEEDED(vkEnumeratePhysicalDevices(Instance, &Count, nullptr));
+		std::vector<VkPhysicalDevice> PDs(Count);
+		VERIFY_SUCCEEDED(vkEnumeratePhysicalDevices(Instance, &Count, PDs.data()));
+		for (const auto i : PDs) {
+			vkGetPhysicalDeviceProperties(i, &PDP);
+			if (DeviceFilter.empty() || std::string::npos != std::string(PDP.deviceName).find(DeviceFilter)) {
+				PhysicalDevice = i;
+				break;
+			}
+		}
+		if (VK_NULL_HANDLE == PhysicalDevice) {
+			std::cerr << "No device matches \"" << DeviceFilter << "\"" << std::endl;
+			return 2;
+		}
+		std::cout << "Device = " << PDP.deviceName << std::endl;
+	}
+
+	//!< Device
+	uint32_t QueueFamilyIndex = 0xffff;
+	uint32_t TimestampValidBits = 0;
+	auto IsMultiDrawIndirect = false;
+	auto IsDrawIndirectFirstInstance = false;
+	auto IsPipelineStatisticsSupported = false;
+	VkDevice Device;
+	VkQueue Queue;
+	{
+		uint32_t Count = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &Count, nullptr);
+		std::vector<VkQueueFamilyProperties> QFPs(Count);
+		vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &Count, QFPs.data());
+		for (uint32_t i = 0; i < QFPs.size(); ++i) {
+			if (VK_QUEUE_GRAPHICS_BIT & QFPs[i].queueFlags) {
+				QueueFamilyIndex = i;
+				TimestampValidBits = QFPs[i].timestampValidBits;
+				break;
+			}
+		}
+		assert(0xffff != QueueFamilyIndex && "");
+
+		const std::array<float, 1> Priorities = { 0.5f };
+		const std::array<VkDeviceQueueCreateInfo, 1> DQCIs = { {
+			{ VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, nullptr, 0, QueueFamilyIndex, static_cast<uint32_t>(Priorities.size()), Priorities.data() },
+		} };
+		VkPhysicalDeviceFeatures PDF;
+		vkGetPhysicalDeviceFeatures(PhysicalDevice, &PDF);
+		IsMultiDrawIndirect = VK_TRUE == PDF.multiDrawIndirect;
+		IsDrawIndirectFirstInstance = VK_TRUE == PDF.drawIndirectFirstInstance;
+		IsPipelineStatisticsSupported = VK_TRUE == PDF.pipelineStatisticsQuery;
+		const VkDeviceCreateInfo DCI = {
+			VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+			nullptr,
+			0,
+			static_cast<uint32_t>(DQCIs.size()), DQCIs.data(),
+			0, nullptr,
+			0, nullptr,
+			&PDF
+		};
+		VERIFY_SUCCEEDED(vkCreateDevice(PhysicalDevice, &DCI, GetAllocationCallbacks(), &Device));
+		vkGetDeviceQueue(Device, QueueFamilyIndex, 0, &Queue);
+	}
+
+	//!< Command
+	VkCommandPool CommandPool;
+	VkCommandBuffer CB;
+	VkFence Fence;
+	{
+		const VkCommandPoolCreateInfo CPCI = {
+			VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			nullptr,
+			VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+			QueueFamilyIndex
+		};
+		VERIFY_SUCCEEDED(vkCreateCommandPool(Device, &CPCI, GetAllocationCallbacks(), &CommandPool));
+		const VkCommandBufferAllocateInfo CBAI = {
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			nullptr,
+			CommandPool,
+			VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			1
+		};
+		VERIFY_SUCCEEDED(vkAllocateCommandBuffers(Device, &CBAI, &CB));
+		const VkFenceCreateInfo FCI = {
+			VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+			nullptr,
+			0
+		};
+		VERIFY_SUCCEEDED(vkCreateFence(Device, &FCI, GetAllocationCallbacks(), &Fence));
+	}
+	const auto SubmitAndWait = [&]() {
+		const std::array<VkSubmitInfo, 1> SIs = { {
+			{ VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr, 0, nullptr, nullptr, 1, &CB, 0, nullptr }
+		} };
+		VERIFY_SUCCEEDED(vkQueueSubmit(Queue, static_cast<uint32_t>(SIs.size()), SIs.data(), Fence));
+		VERIFY_SUCCEEDED(vkWaitForFences(Device, 1, &Fence, VK_TRUE, (std::numeric_limits<uint64_t>::max)()));
+		VERIFY_SUCCEEDED(vkResetFences(Device, 1, &Fence));
+	};
+
+	std::vector<BenchResult> Results;
+	{
+		DeletionQueue PendingDeletions;
+		std::unique_ptr<TextureManager> Textures(new TextureManager(PhysicalDevice, Device, PendingDeletions, 2, 4 * 1024 * 1024, 1024 * 1024));
+		const auto CheckerTexture = Textures->Register(CreateCheckerRGBA8(256, 256, 32, { 0xff, 0xff, 0xff, 0xff }, { 0x40, 0x40, 0x40, 0xff }));
+
+		//!< Color target, read back for the golden image comparison, depth is only tested by the occlusion scenes
+		VkFormat DepthFormat = VK_FORMAT_UNDEFINED;
+		for (const auto i : { VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM }) {
+			VkFormatProperties FP;
+			vkGetPhysicalDeviceFormatProperties(PhysicalDevice, i, &FP);
+			if (FP.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) { DepthFormat = i; break; }
+		}
+		OffscreenTarget Target(PhysicalDevice, Device, Width, Height, DepthFormat);
+
+		//!< Buffers (host visible, the scenes do not measure uploads)
+		const std::array<Vertex_PositionColorTexcoord, 3> Vertices = { {
+			{ { 0.0f, 0.5f, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f }, { 0.5f, 0.0f } }, //!< CT
+			{ { -0.5f, -0.5f, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f }, { 0.0f, 1.0f } }, //!< LB
+			{ { 0.5f, -0.5f, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } }, //!< RB
+		} };
+		const std::array<uint32_t, 3> Indices = { 0, 1, 2 };
+		std::array<BufferObject, 3> Buffers;
+		std::array<DeviceMemoryObject, 3> Memories;
+		std::array<void*, 3> Data;
+		CreateHostVisibleBuffer(Buffers[0], Memories[0], &Data[0], PhysicalDevice, Device, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, sizeof(Vertices));
+		CreateHostVisibleBuffer(Buffers[1], Memories[1], &Data[1], PhysicalDevice, Device, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, sizeof(Indices));
+		CreateHostVisibleBuffer(Buffers[2], Memories[2], &Data[2], PhysicalDevice, Device, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, sizeof(VkDrawIndexedIndirectCommand));
+		memcpy(Data[0], Vertices.data(), sizeof(Vertices));
+		memcpy(Data[1], Indices.data(), sizeof(Indices));
+
+		//!< Pipeline layout
+		PipelineLayoutObject PipelineLayout;
+		{
+			const std::array<VkDescriptorSetLayout, 1> DSLs = { Textures->GetDescriptorSetLayout() };
+			const VkPipelineLayoutCreateInfo PLCI = {
+				VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+				nullptr,
+				0,
+				static_cast<uint32_t>(DSLs.size()), DSLs.data(),
+				0, nullptr
+			};
+			VERIFY_SUCCEEDED(vkCreatePipelineLayout(Device, &PLCI, GetAllocationCallbacks(), PipelineLayout.Put(Device)));
+		}
+
+		//!< Scenes
+		std::vector<BenchScene> Scenes;
+		{
+			PipelineState Triangle;
+			Scenes.push_back({ "Triangle", Triangle, 1 });
+
+			//!< Vertex / setup bound : 128 x 128 small triangles
+			PipelineState Instances;
+			Instances.InstanceGrid = 128;
+			Scenes.push_back({ "Instances", Instances, 128 * 128 });
+
+			//!< Fill bound : stacked screen covering triangles, blended so none of them can be skipped
+			PipelineState Overdraw;
+			Overdraw.Scale = 4.0f;
+			Overdraw.CullMode = VK_CULL_MODE_NONE;
+			Overdraw.BlendEnable = VK_TRUE;
+			Scenes.push_back({ "Overdraw", Overdraw, 64 });
+
+			//!< Rows of meshes receding into the distance, at full detail and with per instance LOD
+			PipelineState Field;
+			Field.Scale = 0.9f;
+			Field.Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+			Field.InstanceGrid = 32;
+			Field.Depth = 15.0f;
+			Scenes.push_back({ "LodOff", Field, 32 * 32, true, false });
+			Scenes.push_back({ "LodOn", Field, 32 * 32, true, true });
+
+			//!< Overdraw heavy : 6 layers of 12 x 12 overlapping meshes drawn back to front, the nearest layer hides most of the others
+			PipelineState Layered;
+			Layered.Scale = 1.3f;
+			Layered.Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+			Layered.InstanceGrid = 12;
+			Layered.Depth = 1.0f;
+			Layered.Layers = 6;
+			Layered.DepthTestEnable = Layered.DepthWriteEnable = VK_TRUE;
+			Scenes.push_back({ "OcclusionOff", Layered, 12 * 12 * 6, true, false, BenchScene::OCCLUSION::NONE });
+			Scenes.push_back({ "OcclusionHiZ", Layered, 12 * 12 * 6, true, false, BenchScene::OCCLUSION::HIZ });
+			Scenes.push_back({ "OcclusionQuery", Layered, 12 * 12 * 6, true, false, BenchScene::OCCLUSION::QUERY });
+		}
+
+		//!< LOD chain built offline by MeshTool, or at startup with the same simplification when the file is missing
+		Mesh Sphere;
+		if (!LoadMesh("Sphere.mesh", Sphere)) {
+			Sphere = CreateBumpySphere(48, 24, 0.08f);
+			BuildLODs(Sphere, 5, 0.5f);
+		}
+		std::cout << "Mesh : LODs = " << Sphere.LODs.size() << ", Triangles = " << Sphere.LODs.front().IndexCount / 3 << " .. " << Sphere.LODs.back().IndexCount / 3 << std::endl;
+		std::array<BufferObject, 3> MeshBuffers;
+		std::array<DeviceMemoryObject, 3> MeshMemories;
+		std::array<void*, 3> MeshData;
+		{
+			uint32_t MaxInstances = 1;
+			for (const auto& i : Scenes) { if (i.IsMesh) { MaxInstances = (std::max)(MaxInstances, i.InstanceCount); } }
+			CreateHostVisibleBuffer(MeshBuffers[0], MeshMemories[0], &MeshData[0], PhysicalDevice, Device, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, Sphere.Vertices.size() * sizeof(Sphere.Vertices[0]));
+			CreateHostVisibleBuffer(MeshBuffers[1], MeshMemories[1], &MeshData[1], PhysicalDevice, Device, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, Sphere.Indices.size() * sizeof(Sphere.Indices[0]));
+			//!< Worst case is one command per instance
+			CreateHostVisibleBuffer(MeshBuffers[2], MeshMemories[2], &MeshData[2], PhysicalDevice, Device, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, MaxInstances * sizeof(VkDrawIndexedIndirectCommand));
+			memcpy(MeshData[0], Sphere.Vertices.data(), Sphere.Vertices.size() * sizeof(Sphere.Vertices[0]));
+			memcpy(MeshData[1], Sphere.Indices.data(), Sphere.Indices.size() * sizeof(Sphere.Indices[0]));
+		}
+		const auto Box = CreateBoundingBox(Sphere.Radius);
+		std::array<BufferObject, 2> BoxBuffers;
+		std::array<DeviceMemoryObject, 2> BoxMemories;
+		std::array<void*, 2> BoxData;
+		CreateHostVisibleBuffer(BoxBuffers[0], BoxMemories[0], &BoxData[0], PhysicalDevice, Device, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, Box.Vertices.size() * sizeof(Box.Vertices[0]));
+		CreateHostVisibleBuffer(BoxBuffers[1], BoxMemories[1], &BoxData[1], PhysicalDevice, Device, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, Box.Indices.size() * sizeof(Box.Indices[0]));
+		memcpy(BoxData[0], Box.Vertices.data(), Box.Vertices.size() * sizeof(Box.Vertices[0]));
+		memcpy(BoxData[1], Box.Indices.data(), Box.Indices.size() * sizeof(Box.Indices[0]));
+
+		//!< Pipelines
+		ShaderModuleObject VS, FS;
+		CreateShaderModule(VS.Put(Device), Device, "VS.spv");
+		CreateShaderModule(FS.Put(Device), Device, "FS.spv");
+		PipelineCacheObject PipelineCache;
+		{
+			const VkPipelineCacheCreateInfo PCCI = {
+				VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+				nullptr,
+				0,
+				0, nullptr
+			};
+			VERIFY_SUCCEEDED(vkCreatePipelineCache(Device, &PCCI, GetAllocationCallbacks(), PipelineCache.Put(Device)));
+		}
+		PipelineFactory Pipelines(Device, PipelineCache, PipelineLayout, Target.GetRenderPass(), VS, FS);
+		std::vector<uint32_t> PipelineIndices;
+		for (const auto& i : Scenes) { PipelineIndices.push_back(Pipelines.Add(i.State)); }
+		//!< Depth only occluders and depth tested (but not written) proxies of the occlusion scenes
+		std::vector<uint32_t> PrepassIndices, ProxyIndices;
+		for (const auto& i : Scenes) {
+			auto Prepass = i.State;
+			Prepass.ColorWriteEnable = VK_FALSE;
+			auto Proxy = Prepass;
+			Proxy.CullMode = VK_CULL_MODE_NONE;
+			Proxy.DepthWriteEnable = VK_FALSE;
+			const auto IsOcclusion = BenchScene::OCCLUSION::NONE != i.Occlusion;
+			PrepassIndices.push_back(IsOcclusion ? Pipelines.Add(Prepass) : (std::numeric_limits<uint32_t>::max)());
+			ProxyIndices.push_back(IsOcclusion ? Pipelines.Add(Proxy) : (std::numeric_limits<uint32_t>::max)());
+		}
+		{
+			ThreadPool Pool;
+			Pipelines.Build(Pool, Pool.GetWorkerCount() + 1);
+		}
+
+		//!< Timestamps
+		QueryPoolObject QueryPool;
+		const auto IsTimestampSupported = 0 != TimestampValidBits && VK_TRUE == PDP.limits.timestampComputeAndGraphics;
+		if (IsTimestampSupported) {
+			const VkQueryPoolCreateInfo QPCI = {
+				VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+				nullptr,
+				0,
+				VK_QUERY_TYPE_TIMESTAMP,
+				2,
+				0
+			};
+			VERIFY_SUCCEEDED(vkCreateQueryPool(Device, &QPCI, GetAllocationCallbacks(), QueryPool.Put(Device)));
+		}
+
+		//!< Fragment shader invocations
+		QueryPoolObject StatisticsPool;
+		if (IsPipelineStatisticsSupported) {
+			const VkQueryPoolCreateInfo QPCI = {
+				VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+				nullptr,
+				0,
+				VK_QUERY_TYPE_PIPELINE_STATISTICS,
+				1,
+				VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+			};
+			VERIFY_SUCCEEDED(vkCreateQueryPool(Device, &QPCI, GetAllocationCallbacks(), StatisticsPool.Put(Device)));
+		}
+
+		//!< Occlusion culling, queries are the fallback where the depth pyramid cannot be built
+		uint32_t MaxOccludees = 1;
+		for (const auto& i : Scenes) { if (BenchScene::OCCLUSION::NONE != i.Occlusion) { MaxOccludees = (std::max)(MaxOccludees, i.InstanceCount); } }
+		ShaderModuleObject HiZCS, CullCS;
+		std::unique_ptr<HiZCuller> HiZ;
+		if (Target.HasDepth() && HiZCuller::IsSupported(PhysicalDevice, DepthFormat)) {
+			CreateShaderModule(HiZCS.Put(Device), Device, "HiZ.spv");
+			CreateShaderModule(CullCS.Put(Device), Device, "Cull.spv");
+			HiZ.reset(new HiZCuller(PhysicalDevice, Device, Target.GetDepthView(), Width, Height, HiZCS, CullCS, MaxOccludees));
+		} else {
+			std::cout << "Hierarchical depth is not supported, OcclusionHiZ falls back to occlusion queries" << std::endl;
+		}
+		QueryCuller Queries(PhysicalDevice, Device, MaxOccludees);
+
+		//!< One call with multiDrawIndirect, one per command otherwise
+		//!< Commands have non zero firstInstance, without drawIndirectFirstInstance they are drawn directly from their host copy (the GPU culled ones as of the previous frame)
+		const auto DrawIndexedIndirect = [&](const VkBuffer Buffer, const VkDrawIndexedIndirectCommand* Commands, const uint32_t FirstCommand, const uint32_t CommandCount) {
+			if (!IsDrawIndirectFirstInstance) {
+				for (uint32_t i = FirstCommand; i < FirstCommand + CommandCount; ++i) {
+					const auto& C = Commands[i];
+					if (C.instanceCount) { vkCmdDrawIndexed(CB, C.indexCount, C.instanceCount, C.firstIndex, C.vertexOffset, C.firstInstance); }
+				}
+				return;
+			}
+			const auto Stride = static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand));
+			if (IsMultiDrawIndirect) {
+				if (CommandCount) { vkCmdDrawIndexedIndirect(CB, Buffer, FirstCommand * Stride, CommandCount, Stride); }
+			} else {
+				for (uint32_t i = 0; i < CommandCount; ++i) { vkCmdDrawIndexedIndirect(CB, Buffer, (FirstCommand + i) * Stride, 1, Stride); }
+			}
+		};
+
+		std::string Baseline;
+		{
+			std::ifstream In(BaselinePath.c_str());
+			if (!In.fail()) { std::stringstream SS; SS << In.rdbuf(); Baseline = SS.str(); }
+			else if (!IsUpdate) { std::cout << "No baseline at " << BaselinePath << ", run with --update on the reference device" << std::endl; }
+		}
+		//!< Numbers of another device (e.g. V3D against a llvmpipe baseline) say nothing about a regression
+		const auto BaselineDevice = FindBaselineDevice(Baseline);
+		const auto IsBaselineDevice = BaselineDevice == PDP.deviceName;
+		if (!IsUpdate && !Baseline.empty() && !IsBaselineDevice) {
+			std::cout << "Baseline was recorded on " << BaselineDevice << ", performance is not compared on " << PDP.deviceName << " (select the device with --device)" << std::endl;
+		}
+
+		for (size_t s = 0; s < Scenes.size(); ++s) {
+			const auto& Scene = Scenes[s];
+			const auto Pipeline = Pipelines.Get(PipelineIndices[s]);
+			BenchResult Result;
+			Result.Name = Scene.Name;
+			Result.Frames = MeasureFrames;
+
+			const VkDrawIndexedIndirectCommand DIIC = { static_cast<uint32_t>(Indices.size()), Scene.InstanceCount, 0, 0, 0 };
+			memcpy(Data[2], &DIIC, sizeof(DIIC));
+			LODSelector Selector(Sphere, Scene.InstanceCount);
+			uint64_t Triangles = 0;
+			uint64_t Fragments = 0;
+
+			const auto Occlusion = BenchScene::OCCLUSION::HIZ == Scene.Occlusion && !HiZ ? BenchScene::OCCLUSION::QUERY : Scene.Occlusion;
+			const auto& Full = Sphere.LODs[0];
+			//!< The nearest layer occludes
+			const auto OccluderCount = static_cast<uint32_t>(Scene.State.InstanceGrid * Scene.State.InstanceGrid);
+			const auto FirstOccluder = Scene.InstanceCount - (std::min)(OccluderCount, Scene.InstanceCount);
+			if (BenchScene::OCCLUSION::NONE != Occlusion) {
+				std::vector<OcclusionBounds> Bounds;
+				std::vector<VkDrawIndexedIndirectCommand> Commands;
+				for (uint32_t i = 0; i < Scene.InstanceCount; ++i) {
+					Bounds.push_back({ GetInstanceRect(Scene.State, i, Sphere.Radius), glm::vec4(GetInstanceDepth(Scene.State, i), 0.0f, 0.0f, 0.0f) });
+					Commands.push_back({ Full.IndexCount, 1, Full.FirstIndex, 0, i });
+				}
+				if (BenchScene::OCCLUSION::HIZ == Occlusion) { HiZ->SetObjects(Bounds, Commands); } else { Queries.SetObjects(Commands); }
+			}
+
+			std::vector<double> FrameMS, CPUFrameMS, GPUFrameMS;
+			FrameMS.reserve(MeasureFrames);
+			CPUFrameMS.reserve(MeasureFrames);
+			GPUFrameMS.reserve(MeasureFrames);
+			for (uint32_t f = 0; f < WarmupFrames + MeasureFrames; ++f) {
+				//!< Warm up lets the texture become resident and the driver settle, counting starts afterwards
+				if (WarmupFrames == f) { Allocator.ResetCounts(); FrameMS.clear(); CPUFrameMS.clear(); GPUFrameMS.clear(); Triangles = Fragments = 0; }
+
+				PendingDeletions.BeginFrame();
+				PendingDeletions.Collect(PendingDeletions.GetFrame() - 1);
+
+				const auto Begin = std::chrono::steady_clock::now();
+
+				//!< Level selection is part of the CPU frame time
+				if (Scene.IsLOD) {
+					Selector.Select([&](const uint32_t i) { return Scene.State.Scale / Scene.State.InstanceGrid / GetInstanceDistance(Scene.State, i) * (std::max)(Width, Height) * 0.5f; });
+					const auto& Commands = Selector.GetCommands();
+					memcpy(MeshData[2], Commands.data(), Commands.size() * sizeof(Commands[0]));
+					Triangles += Selector.GetTriangleCount();
+				} else if (BenchScene::OCCLUSION::NONE != Occlusion) {
+					//!< Counted once the frame has completed
+				} else if (Scene.IsMesh) {
+					Triangles += static_cast<uint64_t>(Sphere.LODs[0].IndexCount / 3) * Scene.InstanceCount;
+				} else {
+					Triangles += static_cast<uint64_t>(Indices.size() / 3) * Scene.InstanceCount;
+				}
+
+				const VkCommandBufferBeginInfo CBBI = {
+					VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+					nullptr,
+					VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+					nullptr
+				};
+				VERIFY_SUCCEEDED(vkBeginCommandBuffer(CB, &CBBI)); {
+					Textures->Touch(CheckerTexture);
+					Textures->Update(CB);
+
+					if (IsTimestampSupported) {
+						vkCmdResetQueryPool(CB, QueryPool, 0, 2);
+						vkCmdWriteTimestamp(CB, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, QueryPool, 0);
+					}
+					if (BenchScene::OCCLUSION::HIZ == Occlusion) { HiZ->Cull(CB); }
+					if (BenchScene::OCCLUSION::QUERY == Occlusion) { Queries.Reset(CB); }
+					if (IsPipelineStatisticsSupported) {
+						vkCmdResetQueryPool(CB, StatisticsPool, 0, 1);
+						vkCmdBeginQuery(CB, StatisticsPool, 0, 0);
+					}
+					std::array<VkClearValue, 2> CVs;
+					CVs[0].color = { { 0.529411793f, 0.807843208f, 0.921568692f, 1.0f } };
+					CVs[1].depthStencil = { 1.0f, 0 };
+					const VkRenderPassBeginInfo RPBI = {
+						VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+						nullptr,
+						Target.GetRenderPass(),
+						Target.GetFramebuffer(),
+						{ { 0, 0 }, { Width, Height } },
+						Target.HasDepth() ? 2u : 1u, CVs.data()
+					};
+					vkCmdBeginRenderPass(CB, &RPBI, VK_SUBPASS_CONTENTS_INLINE); {
+						const std::array<VkViewport, 1> Viewports = { { 0.0f, static_cast<float>(Height), static_cast<float>(Width), -static_cast<float>(Height), 0.0f, 1.0f } };
+						const std::array<VkRect2D, 1> ScissorRects = { {{{ 0, 0 }, { Width, Height }}} };
+						vkCmdSetViewport(CB, 0, static_cast<uint32_t>(Viewports.size()), Viewports.data());
+						vkCmdSetScissor(CB, 0, static_cast<uint32_t>(ScissorRects.size()), ScissorRects.data());
+
+						vkCmdBindPipeline(CB, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline);
+
+						const std::array<VkDescriptorSet, 1> DSs = { Textures->GetDescriptorSet(CheckerTexture) };
+						vkCmdBindDescriptorSets(CB, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout, 0, static_cast<uint32_t>(DSs.size()), DSs.data(), 0, nullptr);
+
+						if (BenchScene::OCCLUSION::NONE != Occlusion) {
+							const std::array<VkBuffer, 1> MeshVBs = { MeshBuffers[0] };
+							const std::array<VkBuffer, 1> BoxVBs = { BoxBuffers[0] };
+							const std::array<VkDeviceSize, 1> Offsets = { 0 };
+							//!< Depth of the occluders first, everything after it is depth tested against them (early fragment tests in FS.frag)
+							vkCmdBindPipeline(CB, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipelines.Get(PrepassIndices[s]));
+							vkCmdBindVertexBuffers(CB, 0, 1, MeshVBs.data(), Offsets.data());
+							vkCmdBindIndexBuffer(CB, MeshBuffers[1], 0, VK_INDEX_TYPE_UINT32);
+							vkCmdDrawIndexed(CB, Full.IndexCount, Scene.InstanceCount - FirstOccluder, Full.FirstIndex, 0, FirstOccluder);
+							if (BenchScene::OCCLUSION::QUERY == Occlusion) {
+								vkCmdBindPipeline(CB, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipelines.Get(ProxyIndices[s]));
+								vkCmdBindVertexBuffers(CB, 0, 1, BoxVBs.data(), Offsets.data());
+								vkCmdBindIndexBuffer(CB, BoxBuffers[1], 0, VK_INDEX_TYPE_UINT32);
+								Queries.Query(CB, [&](const uint32_t i) { vkCmdDrawIndexed(CB, Box.LODs[0].IndexCount, 1, 0, 0, i); });
+							}
+							vkCmdBindPipeline(CB, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline);
+						}
+
+						const std::array<VkBuffer, 1> VBs = { Scene.IsMesh ? MeshBuffers[0] : Buffers[0] };
+						const std::array<VkDeviceSize, 1> Offsets = { 0 };
+						vkCmdBindVertexBuffers(CB, 0, static_cast<uint32_t>(VBs.size()), VBs.data(), Offsets.data());
+						vkCmdBindIndexBuffer(CB, Scene.IsMesh ? MeshBuffers[1] : Buffers[1], 0, VK_INDEX_TYPE_UINT32);
+						if (Scene.IsLOD) {
+							//!< One batch per level, one command per run of instances at that level
+							for (const auto& i : Selector.GetBatches()) { DrawIndexedIndirect(MeshBuffers[2], Selector.GetCommands().data(), i.FirstCommand, i.CommandCount); }
+						} else if (BenchScene::OCCLUSION::NONE != Occlusion) {
+							//!< One command per instance, hidden ones have an instanceCount of 0
+							if (BenchScene::OCCLUSION::HIZ == Occlusion) {
+								DrawIndexedIndirect(HiZ->GetCommandBuffer(), HiZ->GetCommands(), 0, HiZ->GetCount());
+							} else {
+								DrawIndexedIndirect(Queries.GetCommandBuffer(), Queries.GetCommands(), 0, Queries.GetCount());
+							}
+						} else if (Scene.IsMesh) {
+							vkCmdDrawIndexed(CB, Sphere.LODs[0].IndexCount, Scene.InstanceCount, Sphere.LODs[0].FirstIndex, 0, 0);
+						} else {
+							vkCmdDrawIndexedIndirect(CB, Buffers[2], 0, 1, 0);
+						}
+					} vkCmdEndRenderPass(CB);
+					if (IsPipelineStatisticsSupported) { vkCmdEndQuery(CB, StatisticsPool, 0); }
+					//!< Culls the next frame
+					if (BenchScene::OCCLUSION::HIZ == Occlusion) { HiZ->Build(CB); }
+					if (IsTimestampSupported) {
+						vkCmdWriteTimestamp(CB, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, QueryPool, 1);
+					}
+				} VERIFY_SUCCEEDED(vkEndCommandBuffer(CB));
+				const std::array<VkSubmitInfo, 1> SIs = { {
+					{ VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr, 0, nullptr, nullptr, 1, &CB, 0, nullptr }
+				} };
+				VERIFY_SUCCEEDED(vkQueueSubmit(Queue, static_cast<uint32_t>(SIs.size()), SIs.data(), Fence));
+				const auto Submitted = std::chrono::steady_clock::now();
+				VERIFY_SUCCEEDED(vkWaitForFences(Device, 1, &Fence, VK_TRUE, (std::numeric_limits<uint64_t>::max)()));
+				VERIFY_SUCCEEDED(vkResetFences(Device, 1, &Fence));
+				const auto End = std::chrono::steady_clock::now();
+
+				CPUFrameMS.push_back(std::chrono::duration<double, std::milli>(Submitted - Begin).count());
+				FrameMS.push_back(std::chrono::duration<double, std::milli>(End - Begin).count());
+				if (IsTimestampSupported) {
+					std::array<uint64_t, 2> Timestamps;
+					VERIFY_SUCCEEDED(vkGetQueryPoolResults(Device, QueryPool, 0, static_cast<uint32_t>(Timestamps.size()), sizeof(Timestamps), Timestamps.data(), sizeof(Timestamps[0]), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+					const auto Mask = TimestampValidBits < 64 ? (1ull << TimestampValidBits) - 1 : ~0ull;
+					GPUFrameMS.push_back(static_cast<double>((Timestamps[1] - Timestamps[0]) & Mask) * PDP.limits.timestampPeriod * 1.0e-6);
+				}
+				if (IsPipelineStatisticsSupported) {
+					uint64_t Invocations = 0;
+					VERIFY_SUCCEEDED(vkGetQueryPoolResults(Device, StatisticsPool, 0, 1, sizeof(Invocations), &Invocations, sizeof(Invocations), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+					Fragments += Invocations;
+				}
+				if (BenchScene::OCCLUSION::NONE != Occlusion) {
+					//!< Occluders are drawn twice, query proxies are 12 triangles each
+					const auto Visible = BenchScene::OCCLUSION::HIZ == Occlusion ? HiZ->GetVisibleCount() : Queries.GetVisibleCount();
+					Triangles += static_cast<uint64_t>(Full.IndexCount / 3) * (Visible + Scene.InstanceCount - FirstOccluder);
+					if (BenchScene::OCCLUSION::QUERY == Occlusion) {
+						Triangles += static_cast<uint64_t>(Box.LODs[0].IndexCount / 3) * Queries.GetCount();
+						Queries.Feedback();
+					}
+				}
+			}
+			const auto AS = Allocator.GetStats();
+			Result.FrameMS = GetMedian(FrameMS);
+			Result.CPUFrameMS = GetMedian(CPUFrameMS);
+			Result.GPUFrameMS = IsTimestampSupported ? GetMedian(GPUFrameMS) : -1.0;
+			Result.AllocationsPerFrame = static_cast<double>(AS.Allocations + AS.Reallocations) / MeasureFrames;
+			Result.AllocatedBytesPerFrame = static_cast<double>(AS.AllocatedBytes) / MeasureFrames;
+			Result.TrianglesPerFrame = static_cast<double>(Triangles) / MeasureFrames;
+			Result.FragmentsPerFrame = IsPipelineStatisticsSupported ? static_cast<double>(Fragments) / MeasureFrames : -1.0;
+
+			//!< Read back the last frame
+			std::vector<uint8_t> RGB(static_cast<size_t>(Width) * Height * 3);
+			{
+				const VkCommandBufferBeginInfo CBBI = {
+					VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+					nullptr,
+					VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+					nullptr
+				};
+				VERIFY_SUCCEEDED(vkBeginCommandBuffer(CB, &CBBI)); {
+					Target.ReadBack(CB);
+				} VERIFY_SUCCEEDED(vkEndCommandBuffer(CB));
+				SubmitAndWait();
+
+				const auto RGBA = Target.GetPixels();
+				for (size_t i = 0; i < static_cast<size_t>(Width) * Height; ++i) {
+					memcpy(&RGB[i * 3], &RGBA[i * 4], 3);
+				}
+				WritePPM(OutputDir + "/" + Result.Name + ".ppm", Width, Height, RGB);
+			}
+
+			//!< Golden image
+			{
+				const auto GoldenPath = GoldenDir + "/" + Result.Name + ".ppm";
+				uint32_t W, H;
+				std::vector<uint8_t> Golden;
+				if (IsUpdate) {
+					std::filesystem::create_directories(GoldenDir);
+					WritePPM(GoldenPath, Width, Height, RGB);
+					Result.IsNewGolden = true;
+				} else if (LoadPPM(GoldenPath, W, H, Golden)) {
+					if (Width != W || Height != H) {
+						Result.ImageMismatch = 1.0;
+					} else {
+						size_t Mismatch = 0;
+						for (size_t i = 0; i < RGB.size(); i += 3) {
+							for (size_t c = 0; c < 3; ++c) {
+								if (static_cast<uint32_t>(std::abs(RGB[i + c] - Golden[i + c])) > ChannelTolerance) { ++Mismatch; break; }
+							}
+						}
+						Result.ImageMismatch = static_cast<double>(Mismatch) / (static_cast<size_t>(Width) * Height);
+					}
+					if (Result.ImageMismatch > MismatchTolerance) { Result.Failures.push_back("image differs from " + GoldenPath); }
+				} else {
+					//!< A missing golden must not pass silently, the image of this run is in OutputDir for inspection
+					Result.Unverified.push_back("no golden image at " + GoldenPath);
+				}
+			}
+
+			//!< Performance against the baseline
+			if (!IsUpdate && Baseline.empty()) {
+				Result.Unverified.push_back("no baseline at " + BaselinePath);
+			} else if (!IsUpdate && !IsBaselineDevice) {
+				Result.Unverified.push_back("baseline was recorded on " + BaselineDevice);
+			} else if (!IsUpdate) {
+				const auto Compare = [&](const char* Key, const double Value, const double Slack) {
+					double Base;
+					if (!FindBaseline(Baseline, Result.Name, Key, Base)) {
+						Result.Unverified.push_back(std::string("no baseline of ") + Key + " in " + BaselinePath);
+					} else if (Value >= 0.0 && Base >= 0.0 && Value > Base * Tolerance + Slack) {
+						std::stringstream SS;
+						SS << Key << " " << Value << " > baseline " << Base << " x " << Tolerance << " + " << Slack;
+						Result.Failures.push_back(SS.str());
+					}
+				};
+				Compare("FrameMS", Result.FrameMS, SlackMS);
+				Compare("CPUFrameMS", Result.CPUFrameMS, SlackMS);
+				Compare("GPUFrameMS", Result.GPUFrameMS, SlackMS);
+				//!< Steady state should not allocate, half an allocation per frame of slack for sporadic driver work
+				Compare("AllocationsPerFrame", Result.AllocationsPerFrame, 0.5);
+				//!< Catches LOD selection falling back to full detail
+				Compare("TrianglesPerFrame", Result.TrianglesPerFrame, 0.0);
+				//!< Catches occlusion culling that stopped culling
+				Compare("FragmentsPerFrame", Result.FragmentsPerFrame, 0.0);
+			}
+
+			std::cout << Result.Name << " : Frame = " << Result.FrameMS << " msec (CPU = " << Result.CPUFrameMS << ", GPU = " << Result.GPUFrameMS << "), Triangles / Frame = " << static_cast<uint64_t>(Result.TrianglesPerFrame) << ", Fragments / Frame = " << static_cast<int64_t>(Result.FragmentsPerFrame) << ", Allocations / Frame = " << Result.AllocationsPerFrame << ", Mismatch = " << Result.ImageMismatch * 100.0 << " %" << (Result.IsNewGolden ? " (new golden)" : "") << std::endl;
+			for (const auto& i : Result.Failures) { std::cout << "\tFAILED : " << i << std::endl; }
+			for (const auto& i : Result.Unverified) { std::cout << "\tUNVERIFIED : " << i << std::endl; }
+			if (IsStrict) { Result.Failures.insert(Result.Failures.end(), Result.Unverified.cbegin(), Result.Unverified.cend()); }
+			Results.push_back(Result);
+		}
+
+		VERIFY_SUCCEEDED(vkDeviceWaitIdle(Device));
+		Textures.reset();
+		Pipelines.Clear();
+		PendingDeletions.Flush();
+	}
+
+	//!< Result
+	{
+		const auto ResultPath = OutputDir + "/Result.json";
+		std::ofstream Out(ResultPath.c_str());
+		WriteJSON(Out, PDP.deviceName, Results);
+		if (IsUpdate) {
+			std::filesystem::create_directories(BenchDir);
+			std::ofstream Base(BaselinePath.c_str());
+			WriteJSON(Base, PDP.deviceName, Results);
+			std::cout << "Baseline written to " << BaselinePath << std::endl;
+		}
+		std::cout << "Result written to " << ResultPath << std::endl;
+	}
+
+	//!< Destruct
+	{
+		vkDestroyFence(Device, Fence, GetAllocationCallbacks());
+		vkFreeCommandBuffers(Device, CommandPool, 1, &CB);
+		vkDestroyCommandPool(Device, CommandPool, GetAllocationCallbacks());
+		vkDestroyDevice(Device, GetAllocationCallbacks());
+		vkDestroyInstance(Instance, GetAllocationCallbacks());
+	}
+	const auto AS = Allocator.GetStats();
+	std::cout << "Host allocations : Peak = " << AS.PeakBytes / 1024 << " KB" << std::endl;
+
+	//!< Unverified scenes do not fail the run (unless --strict), nothing says they regressed
+	const auto Failed = static_cast<size_t>(std::count_if(Results.cbegin(), Results.cend(), [](const BenchResult& rhs) { return !rhs.Failures.empty(); }));
+	const auto Unverified = static_cast<size_t>(std::count_if(Results.cbegin(), Results.cend(), [](const BenchResult& rhs) { return rhs.Failures.empty() && !rhs.Unverified.empty(); }));
+	std::cout << (Failed ? "REGRESSION" : (Unverified ? "UNVERIFIED" : "PASSED")) << " (" << Results.size() - Failed - Unverified << " / " << Results.size() << " passed, " << Unverified << " unverified)" << std::endl;
+	return Failed ? 1 : 0;
+}
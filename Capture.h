@@ -0,0 +1,375 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <chrono>
+#include <unordered_map>
+
+#include "Common.h"
+#include "PipelineFactory.h"
+#include "Texture.h"
+
+//!< Binary trace of what the application submitted, replayed offscreen by Replay
+//!< Header (MAGIC, VERSION) followed by records of { OP, payload size, payload }
+//!< Resources (shaders, buffers with their contents, textures, pipeline states) come first, then frames of commands referring to them by capture index
+namespace Capture
+{
+	static const uint32_t MAGIC = 0x434b5650; //!< "PVKC"
+	static const uint32_t VERSION = 3;
+
+	enum class OP : uint32_t {
+		TARGET,					//!< Width, Height, VkClearColorValue
+		SHADER,					//!< VkShaderStageFlagBits, SPIR-V
+		BUFFER,					//!< VkBufferUsageFlags, contents
+		TEXTURE,				//!< VkFormat, Width, Height, MipLevels, level count, { size, data } per level
+		PIPELINE,				//!< PipelineState member by member
+		FRAME_BEGIN,			//!< Microseconds since the capture started
+		FRAME_END,
+		SET_VIEWPORT,			//!< VkViewport
+		SET_SCISSOR,			//!< VkRect2D
+		BIND_PIPELINE,			//!< Pipeline
+		BIND_TEXTURE,			//!< Texture (descriptor set 0)
+		BIND_VERTEX_BUFFER,		//!< Buffer, offset (binding 0)
+		BIND_INDEX_BUFFER,		//!< Buffer, offset, VkIndexType
+		DRAW,					//!< VkDrawIndirectCommand
+		DRAW_INDEXED,			//!< VkDrawIndexedIndirectCommand
+		DRAW_INDEXED_INDIRECT,	//!< Buffer, offset, draw count, stride
+	};
+
+	//!< Non dispatchable handles are pointers on 64 bit and uint64_t on 32 bit
+	template<typename T> static uint64_t ToKey(const T Handle) { uint64_t Key = 0; memcpy(&Key, &Handle, sizeof(Handle)); return Key; }
+}
+
+//!< Records resources once and the commands of the first Frames frames
+//!< The Cmd* members call through to Vulkan, so the capture costs a branch when it is not open and a memcpy per command when it is
+//!< Commands of a frame are buffered and written at EndFrame(), a crash loses the partial frame only
+class CaptureWriter
+{
+public:
+	~CaptureWriter() { Close(); }
+
+	bool Open(const std::string& Path, const uint32_t Frames) {
+		Out.open(Path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (Out.fail()) { return false; }
+		FrameLimit = Frames;
+		Origin = std::chrono::steady_clock::now();
+		Put(Capture::MAGIC); Put(Capture::VERSION);
+		Flush();
+		return true;
+	}
+	void Close() {
+		if (!IsOpen()) { return; }
+		Out.close();
+		FrameLimit = 0;
+	}
+	bool IsOpen() const { return Out.is_open(); }
+	uint32_t GetFrameCount() const { return FrameCount; }
+	uint64_t GetWrittenBytes() const { return WrittenBytes; }
+
+	void SetTarget(const uint32_t Width, const uint32_t Height, const VkClearColorValue& Color) {
+		if (!IsOpen()) { return; }
+		Begin(Capture::OP::TARGET); Put(Width); Put(Height); Put(Color); End();
+		Flush();
+	}
+	void AddShader(const VkShaderStageFlagBits Stage, const uint32_t* Code, const size_t Size) {
+		if (!IsOpen()) { return; }
+		Begin(Capture::OP::SHADER); Put(Stage); Put(Code, Size); End();
+		Flush();
+	}
+	bool AddShader(const VkShaderStageFlagBits Stage, const std::string& Path) {
+		if (!IsOpen()) { return true; }
+		std::ifstream In(Path.c_str(), std::ios::in | std::ios::binary);
+		if (In.fail()) { return false; }
+		const std::vector<char> Code((std::istreambuf_iterator<char>(In)), std::istreambuf_iterator<char>());
+		AddShader(Stage, reinterpret_cast<const uint32_t*>(Code.data()), Code.size());
+		return true;
+	}
+	//!< Contents at creation, the replay keeps them unchanged
+	void AddBuffer(const VkBuffer Buffer, const VkBufferUsageFlags Usage, const void* Data, const VkDeviceSize Size) {
+		if (!IsOpen()) { return; }
+		Buffers.emplace(Capture::ToKey(Buffer), static_cast<uint32_t>(Buffers.size()));
+		Begin(Capture::OP::BUFFER); Put(Usage); Put(Data, static_cast<size_t>(Size)); End();
+		Flush();
+	}
+	void AddTexture(const uint32_t Index, const TextureSource& TS) {
+		if (!IsOpen()) { return; }
+		Textures.emplace(Index, static_cast<uint32_t>(Textures.size()));
+		Begin(Capture::OP::TEXTURE);
+		Put(TS.Format); Put(TS.Width); Put(TS.Height); Put(TS.MipLevels); Put(static_cast<uint32_t>(TS.Levels.size()));
+		for (const auto& i : TS.Levels) {
+			Put(static_cast<uint32_t>(i.size())); Put(i.data(), i.size());
+		}
+		End();
+		Flush();
+	}
+	void AddPipeline(const VkPipeline Pipeline, const PipelineState& PS) {
+		if (!IsOpen()) { return; }
+		Pipelines.emplace(Capture::ToKey(Pipeline), static_cast<uint32_t>(Pipelines.size()));
+		Begin(Capture::OP::PIPELINE);
+		Put(PS.Scale); Put(PS.ColorMode); Put(PS.Topology); Put(PS.CullMode); Put(PS.BlendEnable); Put(PS.InstanceGrid); Put(PS.Depth); Put(PS.Layers); Put(PS.DepthTestEnable); Put(PS.DepthWriteEnable); Put(PS.ColorWriteEnable);
+		End();
+		Flush();
+	}
+
+	//!< Around the recording of a frame, closes the capture after the last frame
+	void BeginFrame() {
+		if (!IsOpen()) { return; }
+		Begin(Capture::OP::FRAME_BEGIN);
+		Put(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - Origin).count()));
+		End();
+	}
+	void EndFrame() {
+		if (!IsOpen()) { return; }
+		Begin(Capture::OP::FRAME_END); End();
+		Flush();
+		if (++FrameCount >= FrameLimit) { Close(); }
+	}
+
+	void CmdSetViewport(const VkCommandBuffer CB, const VkViewport& Viewport) {
+		vkCmdSetViewport(CB, 0, 1, &Viewport);
+		if (!IsOpen()) { return; }
+		Begin(Capture::OP::SET_VIEWPORT); Put(Viewport); End();
+	}
+	void CmdSetScissor(const VkCommandBuffer CB, const VkRect2D& Scissor) {
+		vkCmdSetScissor(CB, 0, 1, &Scissor);
+		if (!IsOpen()) { return; }
+		Begin(Capture::OP::SET_SCISSOR); Put(Scissor); End();
+	}
+	void CmdBindPipeline(const VkCommandBuffer CB, const VkPipeline Pipeline) {
+		vkCmdBindPipeline(CB, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline);
+		if (!IsOpen()) { return; }
+		Begin(Capture::OP::BIND_PIPELINE); Put(Find(Pipelines, Capture::ToKey(Pipeline))); End();
+	}
+	//!< Texture is the index of TextureManager, DescriptorSet what it currently returns for it
+	void CmdBindTexture(const VkCommandBuffer CB, const VkPipelineLayout PL, const uint32_t Texture, const VkDescriptorSet DescriptorSet) {
+		vkCmdBindDescriptorSets(CB, VK_PIPELINE_BIND_POINT_GRAPHICS, PL, 0, 1, &DescriptorSet, 0, nullptr);
+		if (!IsOpen()) { return; }
+		Begin(Capture::OP::BIND_TEXTURE); Put(Find(Textures, Texture)); End();
+	}
+	void CmdBindVertexBuffer(const VkCommandBuffer CB, const VkBuffer Buffer, const VkDeviceSize Offset) {
+		vkCmdBindVertexBuffers(CB, 0, 1, &Buffer, &Offset);
+		if (!IsOpen()) { return; }
+		Begin(Capture::OP::BIND_VERTEX_BUFFER); Put(Find(Buffers, Capture::ToKey(Buffer))); Put(Offset); End();
+	}
+	void CmdBindIndexBuffer(const VkCommandBuffer CB, const VkBuffer Buffer, const VkDeviceSize Offset, const VkIndexType IndexType) {
+		vkCmdBindIndexBuffer(CB, Buffer, Offset, IndexType);
+		if (!IsOpen()) { return; }
+		Begin(Capture::OP::BIND_INDEX_BUFFER); Put(Find(Buffers, Capture::ToKey(Buffer))); Put(Offset); Put(IndexType); End();
+	}
+	void CmdDraw(const VkCommandBuffer CB, const VkDrawIndirectCommand& DIC) {
+		vkCmdDraw(CB, DIC.vertexCount, DIC.instanceCount, DIC.firstVertex, DIC.firstInstance);
+		if (!IsOpen()) { return; }
+		Begin(Capture::OP::DRAW); Put(DIC); End();
+	}
+	void CmdDrawIndexed(const VkCommandBuffer CB, const VkDrawIndexedIndirectCommand& DIIC) {
+		vkCmdDrawIndexed(CB, DIIC.indexCount, DIIC.instanceCount, DIIC.firstIndex, DIIC.vertexOffset, DIIC.firstInstance);
+		if (!IsOpen()) { return; }
+		Begin(Capture::OP::DRAW_INDEXED); Put(DIIC); End();
+	}
+	void CmdDrawIndexedIndirect(const VkCommandBuffer CB, const VkBuffer Buffer, const VkDeviceSize Offset, const uint32_t DrawCount, const uint32_t Stride) {
+		vkCmdDrawIndexedIndirect(CB, Buffer, Offset, DrawCount, Stride);
+		if (!IsOpen()) { return; }
+		Begin(Capture::OP::DRAW_INDEXED_INDIRECT); Put(Find(Buffers, Capture::ToKey(Buffer))); Put(Offset); Put(DrawCount); Put(Stride); End();
+	}
+
+private:
+	template<typename T> void Put(const T& rhs) { Put(&rhs, sizeof(rhs)); }
+	void Put(const void* Data, const size_t Size) {
+		const auto Bytes = reinterpret_cast<const uint8_t*>(Data);
+		Pending.insert(Pending.end(), Bytes, Bytes + Size);
+	}
+	//!< Size is patched in End() once the payload is known
+	void Begin(const Capture::OP Op) {
+		Put(Op);
+		RecordBegin = Pending.size();
+		Put(static_cast<uint32_t>(0));
+	}
+	void End() {
+		const auto Size = static_cast<uint32_t>(Pending.size() - RecordBegin - sizeof(uint32_t));
+		memcpy(&Pending[RecordBegin], &Size, sizeof(Size));
+	}
+	void Flush() {
+		Out.write(reinterpret_cast<const char*>(Pending.data()), Pending.size());
+		Out.flush();
+		WrittenBytes += Pending.size();
+		Pending.clear();
+	}
+	//!< Objects used by the captured commands must have been added before
+	template<typename T> static uint32_t Find(const std::unordered_map<T, uint32_t>& Map, const T Key) {
+		const auto It = Map.find(Key);
+		assert(Map.end() != It && "Object was not added to the capture");
+		return Map.end() != It ? It->second : 0;
+	}
+
+	std::ofstream Out;
+	std::vector<uint8_t> Pending;
+	size_t RecordBegin = 0;
+	uint32_t FrameLimit = 0;
+	uint32_t FrameCount = 0;
+	uint64_t WrittenBytes = 0;
+	std::chrono::steady_clock::time_point Origin;
+	std::unordered_map<uint64_t, uint32_t> Buffers;
+	std::unordered_map<uint64_t, uint32_t> Pipelines;
+	std::unordered_map<uint32_t, uint32_t> Textures;
+};
+
+//!< Loads a whole trace and decodes the frames up front, so replaying them costs only the Vulkan calls
+class CaptureReader
+{
+public:
+	struct Shader {
+		VkShaderStageFlagBits Stage;
+		std::vector<uint32_t> Code;
+	};
+	struct Buffer {
+		VkBufferUsageFlags Usage;
+		std::vector<uint8_t> Data;
+	};
+	struct Command {
+		Capture::OP Op;
+		uint32_t Object = 0;		//!< Capture index of the pipeline, texture or buffer
+		VkDeviceSize Offset = 0;
+		VkIndexType IndexType = VK_INDEX_TYPE_UINT32;
+		VkDrawIndirectCommand Draw = {};
+		VkDrawIndexedIndirectCommand DrawIndexed = {};
+		uint32_t DrawCount = 0;		//!< DRAW_INDEXED_INDIRECT
+		uint32_t Stride = 0;
+		VkViewport Viewport = {};
+		VkRect2D Scissor = {};
+	};
+	struct Frame {
+		uint64_t Timestamp = 0;		//!< Microseconds since the capture started
+		std::vector<Command> Commands;
+	};
+
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	VkClearColorValue ClearColor = {};
+	std::vector<Shader> Shaders;
+	std::vector<Buffer> Buffers;
+	std::vector<TextureSource> Textures;
+	std::vector<PipelineState> Pipelines;
+	std::vector<Frame> Frames;
+
+	bool Load(const std::string& Path) {
+		std::ifstream In(Path.c_str(), std::ios::in | std::ios::binary);
+		if (In.fail()) { return false; }
+		Data.assign(std::istreambuf_iterator<char>(In), std::istreambuf_iterator<char>());
+		Cursor = 0;
+
+		uint32_t Magic = 0, Version = 0;
+		if (!Get(Magic) || !Get(Version) || Capture::MAGIC != Magic || Capture::VERSION != Version) { return false; }
+
+		Frame* Current = nullptr;
+		while (Cursor < Data.size()) {
+			Capture::OP Op;
+			uint32_t Size;
+			if (!Get(Op) || !Get(Size) || Cursor + Size > Data.size()) { return false; }
+			const auto RecordEnd = Cursor + Size;
+			switch (Op) {
+			case Capture::OP::TARGET:
+				if (!Get(Width) || !Get(Height) || !Get(ClearColor)) { return false; }
+				break;
+			case Capture::OP::SHADER:
+				Shaders.push_back({});
+				if (!Get(Shaders.back().Stage)) { return false; }
+				Shaders.back().Code.resize((RecordEnd - Cursor) / sizeof(uint32_t));
+				if (!Get(Shaders.back().Code.data(), Shaders.back().Code.size() * sizeof(uint32_t))) { return false; }
+				break;
+			case Capture::OP::BUFFER:
+				Buffers.push_back({});
+				if (!Get(Buffers.back().Usage)) { return false; }
+				Buffers.back().Data.assign(Data.cbegin() + Cursor, Data.cbegin() + RecordEnd);
+				break;
+			case Capture::OP::TEXTURE:
+			{
+				TextureSource TS;
+				uint32_t LevelCount = 0;
+				if (!Get(TS.Format) || !Get(TS.Width) || !Get(TS.Height) || !Get(TS.MipLevels) || !Get(LevelCount)) { return false; }
+				TS.Levels.resize(LevelCount);
+				for (auto& i : TS.Levels) {
+					uint32_t LevelSize = 0;
+					if (!Get(LevelSize)) { return false; }
+					i.resize(LevelSize);
+					if (!Get(i.data(), i.size())) { return false; }
+				}
+				Textures.push_back(std::move(TS));
+				break;
+			}
+			case Capture::OP::PIPELINE:
+			{
+				PipelineState PS;
+				if (!Get(PS.Scale) || !Get(PS.ColorMode) || !Get(PS.Topology) || !Get(PS.CullMode) || !Get(PS.BlendEnable) || !Get(PS.InstanceGrid) || !Get(PS.Depth)
+					|| !Get(PS.Layers) || !Get(PS.DepthTestEnable) || !Get(PS.DepthWriteEnable) || !Get(PS.ColorWriteEnable)) { return false; }
+				Pipelines.push_back(PS);
+				break;
+			}
+			case Capture::OP::FRAME_BEGIN:
+				Frames.push_back({});
+				Current = &Frames.back();
+				if (!Get(Current->Timestamp)) { return false; }
+				break;
+			case Capture::OP::FRAME_END:
+				Current = nullptr;
+				break;
+			default:
+			{
+				//!< Commands outside of a frame are corrupt
+				if (nullptr == Current) { return false; }
+				Command C;
+				C.Op = Op;
+				switch (Op) {
+				case Capture::OP::SET_VIEWPORT: if (!Get(C.Viewport)) { return false; } break;
+				case Capture::OP::SET_SCISSOR: if (!Get(C.Scissor)) { return false; } break;
+				case Capture::OP::BIND_PIPELINE:
+				case Capture::OP::BIND_TEXTURE: if (!Get(C.Object)) { return false; } break;
+				case Capture::OP::BIND_VERTEX_BUFFER: if (!Get(C.Object) || !Get(C.Offset)) { return false; } break;
+				case Capture::OP::BIND_INDEX_BUFFER: if (!Get(C.Object) || !Get(C.Offset) || !Get(C.IndexType)) { return false; } break;
+				case Capture::OP::DRAW: if (!Get(C.Draw)) { return false; } break;
+				case Capture::OP::DRAW_INDEXED: if (!Get(C.DrawIndexed)) { return false; } break;
+				case Capture::OP::DRAW_INDEXED_INDIRECT: if (!Get(C.Object) || !Get(C.Offset) || !Get(C.DrawCount) || !Get(C.Stride)) { return false; } break;
+				default: return false;
+				}
+				Current->Commands.push_back(C);
+				break;
+			}
+			}
+			Cursor = RecordEnd;
+		}
+		//!< A frame cut off by a crash is dropped
+		if (nullptr != Current) { Frames.pop_back(); }
+		Data.clear();
+		return Validate();
+	}
+
+private:
+	template<typename T> bool Get(T& rhs) { return Get(&rhs, sizeof(rhs)); }
+	bool Get(void* Dst, const size_t Size) {
+		if (Cursor + Size > Data.size()) { return false; }
+		memcpy(Dst, &Data[Cursor], Size);
+		Cursor += Size;
+		return true;
+	}
+	//!< Every referenced object exists, so the replay can index without checks
+	bool Validate() const {
+		for (const auto& i : Frames) {
+			for (const auto& j : i.Commands) {
+				switch (j.Op) {
+				case Capture::OP::BIND_PIPELINE: if (j.Object >= Pipelines.size()) { return false; } break;
+				case Capture::OP::BIND_TEXTURE: if (j.Object >= Textures.size()) { return false; } break;
+				case Capture::OP::BIND_VERTEX_BUFFER:
+				case Capture::OP::BIND_INDEX_BUFFER:
+				case Capture::OP::DRAW_INDEXED_INDIRECT: if (j.Object >= Buffers.size()) { return false; } break;
+				default: break;
+				}
+			}
+		}
+		return 0 != Width && 0 != Height;
+	}
+
+	std::vector<uint8_t> Data;
+	size_t Cursor = 0;
+};
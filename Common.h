@@ -0,0 +1,62 @@
+#pragma once
+
+#include <iostream>
+#include <cassert>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <xcb/xcb.h>
+
+//#define VK_USE_PLATFORM_XLB_KHR
+#define VK_USE_PLATFORM_XCB_KHR
+#include <vulkan/vulkan.h>
+
+#define VERIFY_SUCCEEDED(VR) if(VK_SUCCESS != VR) { std::cerr << "VkResult = " << VR << std::endl; assert(false); }
+
+//!< Null uses the driver allocator, a replacement (e.g. the counting allocator of Bench) must be installed before the instance is created and kept until it is destroyed
+inline const VkAllocationCallbacks* InstalledAllocationCallbacks = nullptr;
+inline const VkAllocationCallbacks* GetAllocationCallbacks() { return InstalledAllocationCallbacks; }
+
+inline uint32_t GetMemoryTypeIndex(const VkPhysicalDevice PD, const VkMemoryRequirements& MR, const VkMemoryPropertyFlags MPF) {
+	VkPhysicalDeviceMemoryProperties PDMP;
+	vkGetPhysicalDeviceMemoryProperties(PD, &PDMP);
+	for (uint32_t i = 0; i < PDMP.memoryTypeCount; ++i) {
+		if (MR.memoryTypeBits & (1 << i)) {
+			if ((PDMP.memoryTypes[i].propertyFlags & MPF) == MPF) {
+				return i;
+			}
+		}
+	}
+	return static_cast<uint32_t>(0xffff);
+}
+
+inline void CreateShaderModule(VkShaderModule* ShaderModule, const VkDevice Device, const uint32_t* Code, const size_t Size)
+{
+	const VkShaderModuleCreateInfo SMCI = {
+		VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		nullptr,
+		0,
+		Size, Code
+	};
+	VERIFY_SUCCEEDED(vkCreateShaderModule(Device, &SMCI, GetAllocationCallbacks(), ShaderModule));
+}
+//!< SPIR-V file is mapped and handed to the driver as is, no intermediate copy
+inline void CreateShaderModule(VkShaderModule* ShaderModule, const VkDevice Device, const std::string& Path)
+{
+	const auto FD = open(Path.c_str(), O_RDONLY);
+	if (-1 == FD) { return; }
+	struct stat ST;
+	if (0 == fstat(FD, &ST) && ST.st_size > 0) {
+		const auto Size = static_cast<size_t>(ST.st_size);
+		const auto Data = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, FD, 0);
+		if (MAP_FAILED != Data) {
+			CreateShaderModule(ShaderModule, Device, reinterpret_cast<const uint32_t*>(Data), Size);
+			munmap(Data, Size);
+		}
+	}
+	close(FD);
+}
@@ -4,11 +4,24 @@
 
 layout (early_fragment_tests) in;
 
+//!< 0 : vertex color, 1 : grayscale, 2 : inverted
+layout (constant_id = 1) const int ColorMode = 0;
+
+layout (set = 0, binding = 0) uniform sampler2D Sampler2D;
+
 layout (location = 0) in vec4 InColor;
+layout (location = 1) in vec2 InTexcoord;
 
 layout (location = 0) out vec4 OutColor;
 
 void main()
 {
-	OutColor = InColor;
+	const vec4 Color = InColor * texture(Sampler2D, InTexcoord);
+	if (1 == ColorMode) {
+		OutColor = vec4(vec3(dot(Color.rgb, vec3(0.299f, 0.587f, 0.114f))), Color.a);
+	} else if (2 == ColorMode) {
+		OutColor = vec4(1.0f - Color.rgb, Color.a);
+	} else {
+		OutColor = Color;
+	}
 }
\ No newline at end of file
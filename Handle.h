@@ -0,0 +1,126 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <limits>
+
+#include "Common.h"
+
+//!< Move-only owner of a device-level object, destroyed with Destroy(Device, Handle, AllocationCallbacks)
+template<typename T, void (VKAPI_PTR* Destroy)(VkDevice, T, const VkAllocationCallbacks*)>
+class DeviceObject
+{
+public:
+	DeviceObject() = default;
+	DeviceObject(const VkDevice Dev, const T Hnd) : Device(Dev), Handle(Hnd) {}
+	DeviceObject(const DeviceObject&) = delete;
+	DeviceObject& operator=(const DeviceObject&) = delete;
+	DeviceObject(DeviceObject&& rhs) noexcept : Device(rhs.Device), Handle(rhs.Release()) {}
+	DeviceObject& operator=(DeviceObject&& rhs) noexcept {
+		if (this != &rhs) {
+			Reset();
+			Device = rhs.Device;
+			Handle = rhs.Release();
+		}
+		return *this;
+	}
+	~DeviceObject() { Reset(); }
+
+	T Get() const { return Handle; }
+	operator T() const { return Handle; }
+	explicit operator bool() const { return VK_NULL_HANDLE != Handle; }
+	VkDevice GetDevice() const { return Device; }
+
+	//!< Destroy current object (if any) and return address to be filled by vkCreateXXX
+	T* Put(const VkDevice Dev) { Reset(); Device = Dev; return &Handle; }
+	T Release() { const auto Hnd = Handle; Handle = VK_NULL_HANDLE; return Hnd; }
+	void Reset() {
+		if (VK_NULL_HANDLE != Handle) {
+			Destroy(Device, Handle, GetAllocationCallbacks());
+			Handle = VK_NULL_HANDLE;
+		}
+	}
+
+private:
+	VkDevice Device = VK_NULL_HANDLE;
+	T Handle = VK_NULL_HANDLE;
+};
+
+using BufferObject = DeviceObject<VkBuffer, vkDestroyBuffer>;
+using DeviceMemoryObject = DeviceObject<VkDeviceMemory, vkFreeMemory>;
+using ImageObject = DeviceObject<VkImage, vkDestroyImage>;
+using ImageViewObject = DeviceObject<VkImageView, vkDestroyImageView>;
+using SamplerObject = DeviceObject<VkSampler, vkDestroySampler>;
+using ShaderModuleObject = DeviceObject<VkShaderModule, vkDestroyShaderModule>;
+using PipelineObject = DeviceObject<VkPipeline, vkDestroyPipeline>;
+using PipelineLayoutObject = DeviceObject<VkPipelineLayout, vkDestroyPipelineLayout>;
+using PipelineCacheObject = DeviceObject<VkPipelineCache, vkDestroyPipelineCache>;
+using DescriptorSetLayoutObject = DeviceObject<VkDescriptorSetLayout, vkDestroyDescriptorSetLayout>;
+using DescriptorPoolObject = DeviceObject<VkDescriptorPool, vkDestroyDescriptorPool>;
+using RenderPassObject = DeviceObject<VkRenderPass, vkDestroyRenderPass>;
+using FramebufferObject = DeviceObject<VkFramebuffer, vkDestroyFramebuffer>;
+using QueryPoolObject = DeviceObject<VkQueryPool, vkDestroyQueryPool>;
+using SwapchainObject = DeviceObject<VkSwapchainKHR, vkDestroySwapchainKHR>;
+using SemaphoreObject = DeviceObject<VkSemaphore, vkDestroySemaphore>;
+
+//!< Defers destruction until the GPU is known to be done with an object, so replacing a resource never needs vkDeviceWaitIdle
+//!< Frame serial : incremented once per vkQueueSubmit, an object pushed during serial N is retired once the fence of serial N has signaled
+class DeletionQueue
+{
+public:
+	struct Stats {
+		size_t Pushed = 0;	//!< Objects pushed during the frame
+		size_t Retired = 0;	//!< Objects destroyed during the frame
+		size_t Pending = 0;	//!< Objects still waiting for their fence after Collect()
+	};
+
+	~DeletionQueue() { assert(Entries.empty() && "Flush() must be called after vkDeviceWaitIdle"); }
+
+	uint64_t GetFrame() const { return Frame; }
+	const Stats& GetStats() const { return FrameStats; }
+	size_t GetTotalRetired() const { return TotalRetired; }
+
+	//!< Objects pushed from now on belong to the next submission
+	void BeginFrame() {
+		++Frame;
+		FrameStats = Stats();
+		FrameStats.Pending = Entries.size();
+	}
+	void Push(std::function<void()>&& Fn) {
+		Entries.push_back({ Frame, std::move(Fn) });
+		++FrameStats.Pushed;
+		++FrameStats.Pending;
+	}
+	template<typename T, void (VKAPI_PTR* Destroy)(VkDevice, T, const VkAllocationCallbacks*)>
+	void Push(DeviceObject<T, Destroy>&& Obj) {
+		if (Obj) {
+			const auto Device = Obj.GetDevice();
+			const auto Hnd = Obj.Release();
+			Push([=]() { Destroy(Device, Hnd, GetAllocationCallbacks()); });
+		}
+	}
+	//!< Call after waiting the fence of CompletedFrame, everything pushed up to that serial can go
+	void Collect(const uint64_t CompletedFrame) {
+		while (!Entries.empty() && Entries.front().Frame <= CompletedFrame) {
+			Entries.front().Fn();
+			Entries.pop_front();
+			++FrameStats.Retired;
+			++TotalRetired;
+		}
+		FrameStats.Pending = Entries.size();
+	}
+	//!< Only valid once the device is idle
+	void Flush() { Collect((std::numeric_limits<uint64_t>::max)()); }
+
+private:
+	struct Entry {
+		uint64_t Frame;
+		std::function<void()> Fn;
+	};
+	std::deque<Entry> Entries;
+	uint64_t Frame = 0;
+	Stats FrameStats;
+	size_t TotalRetired = 0;
+};
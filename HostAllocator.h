@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "Common.h"
+
+//!< VkAllocationCallbacks that forward to malloc and count every host allocation the driver makes through them
+//!< Drivers may call back from their own threads, so counters are atomic
+class CountingAllocator
+{
+public:
+	struct Stats {
+		uint64_t Allocations = 0;
+		uint64_t Reallocations = 0;
+		uint64_t Frees = 0;
+		uint64_t InternalAllocations = 0;
+		uint64_t AllocatedBytes = 0;
+		uint64_t PeakBytes = 0;
+	};
+
+	CountingAllocator() {
+		Callbacks.pUserData = this;
+		Callbacks.pfnAllocation = Allocation;
+		Callbacks.pfnReallocation = Reallocation;
+		Callbacks.pfnFree = Free;
+		Callbacks.pfnInternalAllocation = InternalAllocation;
+		Callbacks.pfnInternalFree = InternalFree;
+	}
+
+	const VkAllocationCallbacks* GetCallbacks() const { return &Callbacks; }
+	Stats GetStats() const {
+		Stats S;
+		S.Allocations = Allocations;
+		S.Reallocations = Reallocations;
+		S.Frees = Frees;
+		S.InternalAllocations = InternalAllocations;
+		S.AllocatedBytes = AllocatedBytes;
+		S.PeakBytes = PeakBytes;
+		return S;
+	}
+	//!< Counters only, live and peak bytes span the whole run
+	void ResetCounts() {
+		Allocations = Reallocations = Frees = InternalAllocations = AllocatedBytes = 0;
+	}
+
+private:
+	//!< Placed right before the pointer handed to the driver
+	struct Header {
+		void* Raw;
+		size_t Size;
+	};
+
+	static void* Allocate(CountingAllocator& CA, const size_t Size, const size_t Alignment) {
+		const auto Align = (std::max)(Alignment, alignof(Header));
+		const auto Raw = malloc(Size + Align + sizeof(Header));
+		if (nullptr == Raw) { return nullptr; }
+		const auto Addr = (reinterpret_cast<uintptr_t>(Raw) + sizeof(Header) + Align - 1) / Align * Align;
+		*(reinterpret_cast<Header*>(Addr) - 1) = { Raw, Size };
+
+		CA.AllocatedBytes += Size;
+		const auto Live = (CA.LiveBytes += Size);
+		auto Peak = CA.PeakBytes.load();
+		while (Live > Peak && !CA.PeakBytes.compare_exchange_weak(Peak, Live)) {}
+		return reinterpret_cast<void*>(Addr);
+	}
+	static void Release(CountingAllocator& CA, void* Memory) {
+		const auto& H = *(reinterpret_cast<Header*>(Memory) - 1);
+		CA.LiveBytes -= H.Size;
+		free(H.Raw);
+	}
+
+	static void* VKAPI_PTR Allocation(void* UserData, size_t Size, size_t Alignment, VkSystemAllocationScope /*Scope*/) {
+		auto& CA = *reinterpret_cast<CountingAllocator*>(UserData);
+		++CA.Allocations;
+		return Allocate(CA, Size, Alignment);
+	}
+	static void* VKAPI_PTR Reallocation(void* UserData, void* Original, size_t Size, size_t Alignment, VkSystemAllocationScope /*Scope*/) {
+		auto& CA = *reinterpret_cast<CountingAllocator*>(UserData);
+		++CA.Reallocations;
+		if (nullptr == Original) { return Allocate(CA, Size, Alignment); }
+		if (0 == Size) { Release(CA, Original); return nullptr; }
+		const auto New = Allocate(CA, Size, Alignment);
+		if (nullptr != New) {
+			memcpy(New, Original, (std::min)(Size, (reinterpret_cast<Header*>(Original) - 1)->Size));
+			Release(CA, Original);
+		}
+		return New;
+	}
+	static void VKAPI_PTR Free(void* UserData, void* Memory) {
+		if (nullptr == Memory) { return; }
+		auto& CA = *reinterpret_cast<CountingAllocator*>(UserData);
+		++CA.Frees;
+		Release(CA, Memory);
+	}
+	static void VKAPI_PTR InternalAllocation(void* UserData, size_t /*Size*/, VkInternalAllocationType /*Type*/, VkSystemAllocationScope /*Scope*/) {
+		++reinterpret_cast<CountingAllocator*>(UserData)->InternalAllocations;
+	}
+	static void VKAPI_PTR InternalFree(void* /*UserData*/, size_t /*Size*/, VkInternalAllocationType /*Type*/, VkSystemAllocationScope /*Scope*/) {}
+
+	VkAllocationCallbacks Callbacks;
+	std::atomic<uint64_t> Allocations{ 0 };
+	std::atomic<uint64_t> Reallocations{ 0 };
+	std::atomic<uint64_t> Frees{ 0 };
+	std::atomic<uint64_t> InternalAllocations{ 0 };
+	std::atomic<uint64_t> AllocatedBytes{ 0 };
+	std::atomic<uint64_t> LiveBytes{ 0 };
+	std::atomic<uint64_t> PeakBytes{ 0 };
+};
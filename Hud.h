@@ -0,0 +1,322 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+
+#include "Common.h"
+#include "Handle.h"
+#include "PipelineFactory.h"
+#include "Texture.h"
+
+//!< Performance overlay drawn at the end of the main render pass
+//!< Text and graph are quads from a 5x7 glyph atlas, written into one persistently mapped vertex buffer every frame (one frame in flight, so it is free to rewrite after the fence wait)
+//!< Uses VS.vert / FS.frag as is : the atlas is white with coverage in alpha, solid quads sample a fully covered cell
+class Hud
+{
+public:
+	//!< GPU timings are the deltas between consecutive timestamps written after each pass
+	enum class PASS : uint32_t { UPLOAD, MAIN, OVERLAY, COUNT };
+
+	static PipelineState GetPipelineState() {
+		PipelineState PS;
+		PS.Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		PS.CullMode = VK_CULL_MODE_NONE;
+		PS.BlendEnable = VK_TRUE;
+		return PS;
+	}
+
+	Hud(const VkPhysicalDevice PD, const VkDevice Dev, const uint32_t QueueFamilyIndex, TextureManager& TM, const uint32_t W, const uint32_t H, const bool MemoryBudget)
+		: PhysicalDevice(PD), Device(Dev), Textures(TM), Width(W), Height(H), IsMemoryBudgetSupported(MemoryBudget) {
+		Atlas = Textures.Register(CreateGlyphAtlas());
+
+		const VkBufferCreateInfo BCI = {
+			VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			nullptr,
+			0,
+			sizeof(Vertex_PositionColorTexcoord) * MaxVertices,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_SHARING_MODE_EXCLUSIVE,
+			0, nullptr
+		};
+		VERIFY_SUCCEEDED(vkCreateBuffer(Device, &BCI, GetAllocationCallbacks(), VertexBuffer.Put(Device)));
+		VkMemoryRequirements MR;
+		vkGetBufferMemoryRequirements(Device, VertexBuffer, &MR);
+		const VkMemoryAllocateInfo MAI = {
+			VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			nullptr,
+			MR.size,
+			GetMemoryTypeIndex(PhysicalDevice, MR, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+		};
+		VERIFY_SUCCEEDED(vkAllocateMemory(Device, &MAI, GetAllocationCallbacks(), VertexMemory.Put(Device)));
+		VERIFY_SUCCEEDED(vkBindBufferMemory(Device, VertexBuffer, VertexMemory, 0));
+		void* Data;
+		VERIFY_SUCCEEDED(vkMapMemory(Device, VertexMemory, 0, VK_WHOLE_SIZE, static_cast<VkMemoryMapFlags>(0), &Data));
+		Vertices = reinterpret_cast<Vertex_PositionColorTexcoord*>(Data);
+
+		VkPhysicalDeviceProperties PDP;
+		vkGetPhysicalDeviceProperties(PhysicalDevice, &PDP);
+		TimestampPeriod = PDP.limits.timestampPeriod;
+		uint32_t Count = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &Count, nullptr);
+		std::vector<VkQueueFamilyProperties> QFPs(Count);
+		vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &Count, QFPs.data());
+		const auto ValidBits = QueueFamilyIndex < Count ? QFPs[QueueFamilyIndex].timestampValidBits : 0;
+		TimestampMask = ValidBits < 64 ? (1ull << ValidBits) - 1 : ~0ull;
+		if (VK_TRUE == PDP.limits.timestampComputeAndGraphics && ValidBits) {
+			const VkQueryPoolCreateInfo QPCI = {
+				VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+				nullptr,
+				0,
+				VK_QUERY_TYPE_TIMESTAMP,
+				static_cast<uint32_t>(PASS::COUNT) + 1,
+				0
+			};
+			VERIFY_SUCCEEDED(vkCreateQueryPool(Device, &QPCI, GetAllocationCallbacks(), QueryPool.Put(Device)));
+		}
+
+		vkGetPhysicalDeviceMemoryProperties(PhysicalDevice, &MemoryProperties);
+		HeapUsage.assign(MemoryProperties.memoryHeapCount, 0);
+		HeapBudget.assign(MemoryProperties.memoryHeapCount, 0);
+		for (uint32_t i = 0; i < MemoryProperties.memoryHeapCount; ++i) { HeapBudget[i] = MemoryProperties.memoryHeaps[i].size; }
+	}
+	~Hud() {
+		if (VK_NULL_HANDLE != VertexMemory.Get()) { vkUnmapMemory(Device, VertexMemory); }
+	}
+
+	void Toggle() { IsShown = !IsShown; }
+	bool IsVisible() const { return IsShown; }
+
+	//!< Call after the frame fence wait, the previous frame (and its timestamps) has completed
+	void BeginFrame() {
+		const auto Now = std::chrono::steady_clock::now();
+		if (FrameCount) {
+			const auto FrameMS = std::chrono::duration<float, std::milli>(Now - LastFrame).count();
+			FrameTimes[FrameCount % FrameTimes.size()] = FrameMS;
+			AverageFrameMS += (FrameMS - AverageFrameMS) * 0.05f;
+		}
+		LastFrame = Now;
+		++FrameCount;
+
+		if (QueryPool && IsTimestampWritten) {
+			std::array<uint64_t, static_cast<size_t>(PASS::COUNT) + 1> Timestamps;
+			if (VK_SUCCESS == vkGetQueryPoolResults(Device, QueryPool, 0, static_cast<uint32_t>(Timestamps.size()), sizeof(Timestamps), Timestamps.data(), sizeof(Timestamps[0]), VK_QUERY_RESULT_64_BIT)) {
+				for (size_t i = 0; i < PassMS.size(); ++i) {
+					PassMS[i] = static_cast<float>((Timestamps[i + 1] - Timestamps[i]) & TimestampMask) * TimestampPeriod * 1.0e-6f;
+				}
+			}
+		}
+		IsTimestampWritten = false;
+
+		//!< Budget query is not free, a few times per second is enough
+		if (IsShown && IsMemoryBudgetSupported && 0 == FrameCount % 30) {
+			VkPhysicalDeviceMemoryBudgetPropertiesEXT PDMBP = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT, nullptr, {}, {} };
+			VkPhysicalDeviceMemoryProperties2 PDMP2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2, &PDMBP, {} };
+			vkGetPhysicalDeviceMemoryProperties2(PhysicalDevice, &PDMP2);
+			for (uint32_t i = 0; i < MemoryProperties.memoryHeapCount; ++i) {
+				HeapUsage[i] = PDMBP.heapUsage[i];
+				HeapBudget[i] = PDMBP.heapBudget[i];
+			}
+		}
+
+		PrevDrawCount = DrawCount;
+		DrawCount = 0;
+		if (IsShown) { Textures.Touch(Atlas); }
+	}
+
+	//!< First command of the frame (outside of render pass)
+	void BeginCommand(const VkCommandBuffer CB) {
+		if (!QueryPool) { return; }
+		vkCmdResetQueryPool(CB, QueryPool, 0, static_cast<uint32_t>(PASS::COUNT) + 1);
+		vkCmdWriteTimestamp(CB, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, QueryPool, 0);
+	}
+	void EndPass(const VkCommandBuffer CB, const PASS Pass) {
+		if (!QueryPool) { return; }
+		vkCmdWriteTimestamp(CB, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, QueryPool, static_cast<uint32_t>(Pass) + 1);
+		IsTimestampWritten = PASS::OVERLAY == Pass;
+	}
+
+	void AddDraws(const uint32_t Count) { DrawCount += Count; }
+
+	//!< Inside the render pass, Pipeline is created from GetPipelineState()
+	void Draw(const VkCommandBuffer CB, const VkPipeline Pipeline, const VkPipelineLayout PipelineLayout) {
+		if (!IsShown || !Textures.IsSampleable(Atlas)) { return; }
+
+		VertexCount = 0;
+		const glm::vec4 Panel(0.0f, 0.0f, 0.0f, 0.6f);
+		const glm::vec4 White(1.0f, 1.0f, 1.0f, 1.0f);
+		const float Left = 8.0f, Top = 8.0f;
+		const float GraphW = static_cast<float>(FrameTimes.size()) * 2.0f, GraphH = 64.0f;
+		const float LineH = GlyphH * Scale + 4.0f;
+		const auto Lines = 1 + MemoryProperties.memoryHeapCount;
+		AddSolid(Left - 4.0f, Top - 4.0f, GraphW + 8.0f + 240.0f, GraphH + 8.0f + LineH * Lines, Panel);
+
+		//!< Frame time graph, full height is 33.3 msec, marker at 16.7 msec
+		for (size_t i = 0; i < FrameTimes.size(); ++i) {
+			const auto MS = FrameTimes[(FrameCount + i) % FrameTimes.size()];
+			const auto H = (std::min)(MS / 33.3f, 1.0f) * GraphH;
+			const auto Color = MS < 17.0f ? glm::vec4(0.2f, 1.0f, 0.2f, 1.0f) : (MS < 34.0f ? glm::vec4(1.0f, 1.0f, 0.2f, 1.0f) : glm::vec4(1.0f, 0.2f, 0.2f, 1.0f));
+			AddSolid(Left + i * 2.0f, Top + GraphH - H, 2.0f, H, Color);
+		}
+		AddSolid(Left, Top + GraphH * 0.5f, GraphW, 1.0f, glm::vec4(1.0f, 1.0f, 1.0f, 0.5f));
+
+		char Buf[128];
+		auto X = Left + GraphW + 8.0f, Y = Top;
+		snprintf(Buf, sizeof(Buf), "FPS %.1f", AverageFrameMS > 0.0f ? 1000.0f / AverageFrameMS : 0.0f);
+		AddText(X, Y, Buf, White); Y += LineH;
+		snprintf(Buf, sizeof(Buf), "%.2f MS", AverageFrameMS);
+		AddText(X, Y, Buf, White); Y += LineH;
+		snprintf(Buf, sizeof(Buf), "DRAWS %u", PrevDrawCount);
+		AddText(X, Y, Buf, White);
+
+		X = Left; Y = Top + GraphH + 8.0f;
+		if (QueryPool) {
+			snprintf(Buf, sizeof(Buf), "GPU UPLOAD %.2f MAIN %.2f HUD %.2f MS", PassMS[0], PassMS[1], PassMS[2]);
+		} else {
+			snprintf(Buf, sizeof(Buf), "GPU -");
+		}
+		AddText(X, Y, Buf, White); Y += LineH;
+		for (uint32_t i = 0; i < MemoryProperties.memoryHeapCount; ++i) {
+			const auto IsDeviceLocal = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT & MemoryProperties.memoryHeaps[i].flags;
+			if (IsMemoryBudgetSupported) {
+				snprintf(Buf, sizeof(Buf), "HEAP%u%s %.1f/%.1f MB", i, IsDeviceLocal ? " LOCAL" : "", HeapUsage[i] / (1024.0 * 1024.0), HeapBudget[i] / (1024.0 * 1024.0));
+			} else {
+				snprintf(Buf, sizeof(Buf), "HEAP%u%s -/%.1f MB", i, IsDeviceLocal ? " LOCAL" : "", HeapBudget[i] / (1024.0 * 1024.0));
+			}
+			AddText(X, Y, Buf, White); Y += LineH;
+		}
+
+		if (!VertexCount) { return; }
+		vkCmdBindPipeline(CB, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline);
+		const std::array<VkDescriptorSet, 1> DSs = { Textures.GetDescriptorSet(Atlas) };
+		vkCmdBindDescriptorSets(CB, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout, 0, static_cast<uint32_t>(DSs.size()), DSs.data(), 0, nullptr);
+		const std::array<VkBuffer, 1> VBs = { VertexBuffer };
+		const std::array<VkDeviceSize, 1> Offsets = { 0 };
+		vkCmdBindVertexBuffers(CB, 0, static_cast<uint32_t>(VBs.size()), VBs.data(), Offsets.data());
+		vkCmdDraw(CB, VertexCount, 1, 0, 0);
+		AddDraws(1);
+	}
+
+private:
+	static const uint32_t MaxVertices = 6 * 1024;
+	static const uint32_t AtlasW = 128, AtlasH = 64, Cell = 8, GlyphW = 5, GlyphH = 7;
+	static constexpr float Scale = 2.0f;
+	static const char SolidChar = 127;
+
+	//!< ASCII 32-127 in 16 x 6 cells of 8x8, glyphs at the top left of their cell, DEL is a solid cell
+	static TextureSource CreateGlyphAtlas() {
+		static const struct { char Char; uint8_t Rows[GlyphH]; } Glyphs[] = {
+			{ '0', { 0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e } }, { '1', { 0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e } },
+			{ '2', { 0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f } }, { '3', { 0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e } },
+			{ '4', { 0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02 } }, { '5', { 0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e } },
+			{ '6', { 0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e } }, { '7', { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 } },
+			{ '8', { 0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e } }, { '9', { 0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c } },
+			{ 'A', { 0x0e, 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11 } }, { 'B', { 0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e } },
+			{ 'C', { 0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e } }, { 'D', { 0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c } },
+			{ 'E', { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f } }, { 'F', { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10 } },
+			{ 'G', { 0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f } }, { 'H', { 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 } },
+			{ 'I', { 0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e } }, { 'J', { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c } },
+			{ 'K', { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 } }, { 'L', { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f } },
+			{ 'M', { 0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11 } }, { 'N', { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 } },
+			{ 'O', { 0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e } }, { 'P', { 0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10 } },
+			{ 'Q', { 0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d } }, { 'R', { 0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11 } },
+			{ 'S', { 0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e } }, { 'T', { 0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 } },
+			{ 'U', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e } }, { 'V', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04 } },
+			{ 'W', { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a } }, { 'X', { 0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11 } },
+			{ 'Y', { 0x11, 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04 } }, { 'Z', { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f } },
+			{ '.', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c } }, { ':', { 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00 } },
+			{ '/', { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 } }, { '-', { 0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00 } },
+			{ '%', { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 } }, { '=', { 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00 } },
+			{ '(', { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 } }, { ')', { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 } },
+		};
+
+		TextureSource TS;
+		TS.Width = AtlasW;
+		TS.Height = AtlasH;
+		TS.Levels.push_back(std::vector<uint8_t>(AtlasW * AtlasH * 4, 0));
+		auto& Texels = TS.Levels.back();
+		const auto Plot = [&](const uint32_t x, const uint32_t y) {
+			auto T = &Texels[(y * AtlasW + x) * 4];
+			T[0] = T[1] = T[2] = T[3] = 0xff;
+		};
+		for (const auto& i : Glyphs) {
+			const auto Index = static_cast<uint32_t>(i.Char - 32);
+			for (uint32_t y = 0; y < GlyphH; ++y) {
+				for (uint32_t x = 0; x < GlyphW; ++x) {
+					if (i.Rows[y] & (0x10 >> x)) { Plot(Index % 16 * Cell + x, Index / 16 * Cell + y); }
+				}
+			}
+		}
+		const auto Solid = static_cast<uint32_t>(SolidChar - 32);
+		for (uint32_t y = 0; y < Cell; ++y) {
+			for (uint32_t x = 0; x < Cell; ++x) { Plot(Solid % 16 * Cell + x, Solid / 16 * Cell + y); }
+		}
+		return TS;
+	}
+
+	//!< Pixel coordinates with the origin at the top left
+	void AddQuad(const float X, const float Y, const float W, const float H, const glm::vec2& UV0, const glm::vec2& UV1, const glm::vec4& Color) {
+		if (VertexCount + 6 > MaxVertices) { return; }
+		const auto L = X / Width * 2.0f - 1.0f, R = (X + W) / Width * 2.0f - 1.0f;
+		const auto T = 1.0f - Y / Height * 2.0f, B = 1.0f - (Y + H) / Height * 2.0f;
+		const std::array<Vertex_PositionColorTexcoord, 4> Corners = { {
+			{ { L, T, 0.0f }, Color, { UV0.x, UV0.y } },
+			{ { L, B, 0.0f }, Color, { UV0.x, UV1.y } },
+			{ { R, T, 0.0f }, Color, { UV1.x, UV0.y } },
+			{ { R, B, 0.0f }, Color, { UV1.x, UV1.y } },
+		} };
+		for (const auto i : { 0, 1, 2, 2, 1, 3 }) { Vertices[VertexCount++] = Corners[i]; }
+	}
+	void AddSolid(const float X, const float Y, const float W, const float H, const glm::vec4& Color) {
+		const auto Solid = static_cast<uint32_t>(SolidChar - 32);
+		const glm::vec2 UV((Solid % 16 * Cell + Cell * 0.5f) / AtlasW, (Solid / 16 * Cell + Cell * 0.5f) / AtlasH);
+		AddQuad(X, Y, W, H, UV, UV, Color);
+	}
+	void AddText(float X, const float Y, const char* Str, const glm::vec4& Color) {
+		for (; *Str; ++Str) {
+			auto C = *Str;
+			if ('a' <= C && C <= 'z') { C -= 'a' - 'A'; }
+			if (' ' < C && C < SolidChar) {
+				const auto Index = static_cast<uint32_t>(C - 32);
+				const glm::vec2 UV0(static_cast<float>(Index % 16 * Cell) / AtlasW, static_cast<float>(Index / 16 * Cell) / AtlasH);
+				const glm::vec2 UV1(static_cast<float>(Index % 16 * Cell + GlyphW) / AtlasW, static_cast<float>(Index / 16 * Cell + GlyphH) / AtlasH);
+				AddQuad(X, Y, GlyphW * Scale, GlyphH * Scale, UV0, UV1, Color);
+			}
+			X += (GlyphW + 1) * Scale;
+		}
+	}
+
+	VkPhysicalDevice PhysicalDevice;
+	VkDevice Device;
+	TextureManager& Textures;
+	uint32_t Atlas;
+	float Width, Height;
+	bool IsMemoryBudgetSupported;
+	bool IsShown = false;
+
+	BufferObject VertexBuffer;
+	DeviceMemoryObject VertexMemory;
+	Vertex_PositionColorTexcoord* Vertices = nullptr;
+	uint32_t VertexCount = 0;
+
+	QueryPoolObject QueryPool;
+	float TimestampPeriod = 1.0f;
+	uint64_t TimestampMask = ~0ull;		//!< Deltas wrap at timestampValidBits
+	bool IsTimestampWritten = false;
+	std::array<float, static_cast<size_t>(PASS::COUNT)> PassMS = {};
+
+	std::array<float, 128> FrameTimes = {};
+	float AverageFrameMS = 0.0f;
+	uint64_t FrameCount = 0;
+	std::chrono::steady_clock::time_point LastFrame;
+
+	VkPhysicalDeviceMemoryProperties MemoryProperties;
+	std::vector<VkDeviceSize> HeapUsage;
+	std::vector<VkDeviceSize> HeapBudget;
+
+	uint32_t DrawCount = 0;
+	uint32_t PrevDrawCount = 0;
+};
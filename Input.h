@@ -0,0 +1,119 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+
+#include <xcb/xcb.h>
+
+#include "SPSCRing.h"
+
+//!< Compact record of an X event, Timestamp is steady_clock nanoseconds when the event was pulled from the connection
+struct InputEvent
+{
+	enum class TYPE : uint8_t { KEY_PRESS, KEY_RELEASE, EXPOSE };
+	//!< Keycodes of the evdev keymap used by Xorg on Raspberry Pi OS
+	enum KEYCODE : uint8_t { KEYCODE_ESCAPE = 9, KEYCODE_F1 = 67 };
+	TYPE Type;
+	uint8_t Detail;		//!< Keycode
+	uint16_t State;		//!< Modifier mask
+	uint64_t Timestamp;
+};
+
+static uint64_t GetTimestampNS()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//!< Pulls XCB events on its own thread so neither xcb_wait_for_event nor a slow frame delays the other
+class InputThread
+{
+public:
+	using Ring = SPSCRing<InputEvent, 256>;
+
+	void Start(xcb_connection_t* Con, const xcb_window_t Win) {
+		Connection = Con;
+		Window = Win;
+		Thread = std::thread([this]() { Run(); });
+	}
+	//!< Wakes the thread blocked in xcb_wait_for_event with a client message, then joins
+	void Stop() {
+		if (!Thread.joinable()) { return; }
+		IsQuit = true;
+		xcb_client_message_event_t CME = {};
+		CME.response_type = XCB_CLIENT_MESSAGE;
+		CME.format = 32;
+		CME.window = Window;
+		CME.type = XCB_ATOM_NONE;
+		xcb_send_event(Connection, 0, Window, XCB_EVENT_MASK_NO_EVENT, reinterpret_cast<const char*>(&CME));
+		xcb_flush(Connection);
+		Thread.join();
+	}
+
+	//!< Render thread only
+	bool Pop(InputEvent& IE) { return Events.Pop(IE); }
+	uint32_t GetDroppedCount() const { return DroppedCount; }
+	//!< Not sent through the ring, a full ring would drop it
+	bool IsQuitRequested() const { return IsDisconnected; }
+
+private:
+	void Push(const InputEvent& IE) {
+		if (!Events.Push(IE)) { ++DroppedCount; }
+	}
+	void Run() {
+		xcb_generic_event_t* Event;
+		while (!IsQuit && (Event = xcb_wait_for_event(Connection))) {
+			const auto Timestamp = GetTimestampNS();
+			switch (Event->response_type & ~0x80) {
+			case XCB_KEY_PRESS:
+			{
+				const auto KPE = reinterpret_cast<const xcb_key_press_event_t*>(Event);
+				Push({ InputEvent::TYPE::KEY_PRESS, KPE->detail, KPE->state, Timestamp });
+			}
+			break;
+			case XCB_KEY_RELEASE:
+			{
+				const auto KRE = reinterpret_cast<const xcb_key_release_event_t*>(Event);
+				Push({ InputEvent::TYPE::KEY_RELEASE, KRE->detail, KRE->state, Timestamp });
+			}
+			break;
+			case XCB_EXPOSE:
+				Push({ InputEvent::TYPE::EXPOSE, 0, 0, Timestamp });
+				break;
+			default: break;
+			}
+			free(Event);
+		}
+		//!< Connection lost or stopped
+		if (!IsQuit) {
+			IsDisconnected = true;
+		}
+	}
+
+	xcb_connection_t* Connection = nullptr;
+	xcb_window_t Window = 0;
+	std::thread Thread;
+	std::atomic<bool> IsQuit{ false };
+	std::atomic<bool> IsDisconnected{ false };
+	std::atomic<uint32_t> DroppedCount{ 0 };
+	Ring Events;
+};
+
+//!< Time from the event leaving the X connection until the render thread consumed it
+struct InputLatency
+{
+	void Add(const InputEvent& IE) {
+		const auto Latency = GetTimestampNS() - IE.Timestamp;
+		++Count;
+		Total += Latency;
+		Max = (std::max)(Max, Latency);
+	}
+	double GetAverageMS() const { return Count ? static_cast<double>(Total) / Count * 1.0e-6 : 0.0; }
+	double GetMaxMS() const { return static_cast<double>(Max) * 1.0e-6; }
+
+	uint64_t Count = 0;
+	uint64_t Total = 0;
+	uint64_t Max = 0;
+};
@@ -6,18 +6,30 @@
 #include <numeric>
 #include <chrono>
 #include <thread>
-
-#include <xcb/xcb.h>
-
-//#define VK_USE_PLATFORM_XLB_KHR
-#define VK_USE_PLATFORM_XCB_KHR
-#include <vulkan/vulkan.h>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <future>
 
 #include <glm/glm.hpp>
 
-#define VERIFY_SUCCEEDED(VR) if(VK_SUCCESS != VR) { std::cerr << "VkResult = " << VR << std::endl; assert(false); } 
+#include "Common.h"
+#include "Handle.h"
+#include "PipelineFactory.h"
+#include "Input.h"
+#include "Texture.h"
+#include "Hud.h"
+#include "Trace.h"
+#include "Capture.h"
+#include "Present.h"
+#ifdef EMBED_SPIRV
+#include "VS.spv.h"
+#include "FS.spv.h"
+#endif
 
-const VkAllocationCallbacks* GetAllocationCallbacks() { return nullptr; }
 static bool IsAligned(const size_t Size, const size_t Align) { return !(Size & ~Align); }
 static size_t RoundDown(const size_t Size, const size_t Align) {
 	if (IsAligned(Size, Align)) { return Size; }
@@ -42,19 +54,6 @@ static void CreateBuffer(VkBuffer* Buffer, const VkDevice Device, const VkBuffer
 	VERIFY_SUCCEEDED(vkCreateBuffer(Device, &BCI, GetAllocationCallbacks(), Buffer));
 }
 
-static uint32_t GetMemoryTypeIndex(const VkPhysicalDevice PD, const VkMemoryRequirements& MR, const VkMemoryPropertyFlags MPF) {
-	VkPhysicalDeviceMemoryProperties PDMP;
-	vkGetPhysicalDeviceMemoryProperties(PD, &PDMP);
-	for (uint32_t i = 0; i < PDMP.memoryTypeCount; ++i) {
-		if (MR.memoryTypeBits & (1 << i)) {
-			if ((PDMP.memoryTypes[i].propertyFlags & MPF) == MPF) {
-				return i;
-			}
-		}
-	}
-	return static_cast<uint32_t>(0xffff);
-};
-
 static void CreateDeviceMemory(std::vector<VkDeviceMemory>& DMs, const VkDevice Device, const std::vector<std::vector<VkMemoryRequirements>>& MRs)
 {
 	DMs.assign(MRs.size(), VK_NULL_HANDLE);
@@ -71,43 +70,53 @@ static void CreateDeviceMemory(std::vector<VkDeviceMemory>& DMs, const VkDevice
 	}
 }
 
-static void CreateShaderModule(VkShaderModule* ShaderModule, const VkDevice Device, const std::string& Path)
+int main(int argc, char* argv[])
 {
-	std::ifstream In(Path.c_str(), std::ios::in | std::ios::binary);
-	if (!In.fail()) {
-		In.seekg(0, std::ios_base::end);
-		const auto Size = In.tellg();
-		In.seekg(0, std::ios_base::beg);
-		if (Size) {
-			auto Data = new char[Size];
-			In.read(Data, Size);
-			const VkShaderModuleCreateInfo SMCI = {
-				VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-				nullptr,
-				0,
-				static_cast<size_t>(Size), reinterpret_cast<uint32_t*>(Data)
-			};
-			VERIFY_SUCCEEDED(vkCreateShaderModule(Device, &SMCI, GetAllocationCallbacks(), ShaderModule));
-			delete[] Data;
+	//!< Startup phases, written as Chrome trace with --trace
+	Tracer Trace;
+
+	//!< Options
+	auto IsPipelineBench = false;
+	auto IsVerbose = false;		//!< Layer, extension and device enumeration output
+	std::string TracePath;
+	std::string CapturePath;		//!< Command stream of the first CaptureFrames frames, replayed with Replay
+	uint32_t CaptureFrames = 300;
+	auto IsSyncPresent = false;	//!< Acquire and present on the render thread (the path before the present thread), for comparison
+	uint32_t SwapchainImageCount = 3;	//!< Same in both present paths, so that --sync-present only changes the thread
+	for (auto i = 1; i < argc; ++i) {
+		if (std::string("--pipeline-bench") == argv[i]) { IsPipelineBench = true; }
+		if (std::string("--verbose") == argv[i]) { IsVerbose = true; }
+		if (std::string("--trace") == argv[i] && i + 1 < argc) { TracePath = argv[++i]; }
+		if (std::string("--capture") == argv[i] && i + 1 < argc) { CapturePath = argv[++i]; }
+		if (std::string("--capture-frames") == argv[i] && i + 1 < argc) { CaptureFrames = static_cast<uint32_t>((std::max)(1, std::atoi(argv[++i]))); }
+		if (std::string("--sync-present") == argv[i]) { IsSyncPresent = true; }
+		if (std::string("--swapchain-images") == argv[i] && i + 1 < argc) { SwapchainImageCount = static_cast<uint32_t>((std::max)(1, std::atoi(argv[++i]))); }
+	}
+
+	//!< Resources are added as they are created, so it has to be open before any of them
+	CaptureWriter Capture;
+	const VkClearValue ClearValue = { { 0.529411793f, 0.807843208f, 0.921568692f, 1.0f } };
+	if (!CapturePath.empty()) {
+		if (Capture.Open(CapturePath, CaptureFrames)) {
+			Capture.SetTarget(1280, 720, ClearValue.color);
+		} else {
+			std::cerr << "Cannot open " << CapturePath << std::endl;
 		}
-		In.close();
 	}
-}
 
-int main()
-{
-	//!< X-Window
+	//!< X-Window (round trips to the X server overlap with instance creation)
 	xcb_connection_t* Connection;
 	xcb_window_t Window;
 	xcb_screen_t* Screen;
-	{
+	auto WindowSetup = std::async(std::launch::async, [&]() {
+		const Tracer::Scope Scope(Trace, "Window");
 		Connection = xcb_connect(nullptr, nullptr);
 		assert(0 == xcb_connection_has_error(Connection) && "");
 
 		Screen = xcb_setup_roots_iterator(xcb_get_setup(Connection)).data;
 
 		Window = xcb_generate_id(Connection);
-		const std::array<uint32_t, 2> Values = { Screen->white_pixel, XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_KEY_PRESS };
+		const std::array<uint32_t, 2> Values = { Screen->white_pixel, XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_KEY_PRESS | XCB_EVENT_MASK_KEY_RELEASE };
 		xcb_create_window(Connection, Screen->root_depth, Window, Screen->root,
 			0, 0, 1280, 720, 1,
 			XCB_WINDOW_CLASS_INPUT_OUTPUT, Screen->root_visual,
@@ -115,7 +124,7 @@ int main()
 
 		xcb_map_window(Connection, Window);
 		xcb_flush(Connection);
-	}
+	});
 
 	//!< Version
 	uint32_t APIVersion;
@@ -128,7 +137,8 @@ int main()
 	}
 
 	//!< Layers, Extensions
-	{
+	if (IsVerbose) {
+		const Tracer::Scope Scope(Trace, "Layers");
 		uint32_t Count = 0;
 		VERIFY_SUCCEEDED(vkEnumerateInstanceLayerProperties(&Count, nullptr));
 		if (Count) {
@@ -152,6 +162,7 @@ int main()
 	//!< Instance
 	VkInstance Instance;
 	{
+		const Tracer::Scope Scope(Trace, "Instance");
 		const VkApplicationInfo AI = {
 			VK_STRUCTURE_TYPE_APPLICATION_INFO,
 			nullptr,
@@ -194,6 +205,7 @@ int main()
 
 	//!< surface
 	VkSurfaceKHR Surface = VK_NULL_HANDLE;
+	WindowSetup.get();
 	{
 		const VkXcbSurfaceCreateInfoKHR SCI = {
 			VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR,
@@ -209,40 +221,43 @@ int main()
 	std::vector<VkPhysicalDevice> PhysicalDevices;
 	//std::vector<VkPhysicalDeviceMemoryProperties> PhysicalDeivceMemoryProperties;
 	{
+		const Tracer::Scope Scope(Trace, "PhysicalDevice");
 		uint32_t Count = 0;
 		VERIFY_SUCCEEDED(vkEnumeratePhysicalDevices(Instance, &Count, nullptr));
 		PhysicalDevices.resize(Count);
 		VERIFY_SUCCEEDED(vkEnumeratePhysicalDevices(Instance, &Count, PhysicalDevices.data()));
-		for (const auto& i : PhysicalDevices) {
-			VkPhysicalDeviceProperties PDP;
-			vkGetPhysicalDeviceProperties(i, &PDP);
-			if (VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU == PDP.deviceType) { std::cout << "INTEGRATED_GPU" << std::endl; }
-			if (VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU == PDP.deviceType) { std::cout << "DISCRETE_GPU" << std::endl; }
-			std::cout << "maxUniformBufferRange = " << PDP.limits.maxUniformBufferRange << std::endl;
-			std::cout << "maxFragmentOutputAttachments = " << PDP.limits.maxFragmentOutputAttachments << std::endl;
-			std::cout << "maxColorAttachments = " << PDP.limits.maxColorAttachments << std::endl;
-
-			VkPhysicalDeviceFeatures PDF;
-			vkGetPhysicalDeviceFeatures(i, &PDF);
-			if (PDF.geometryShader) { std::cout << "geometryShader" << std::endl; }
-			if (PDF.tessellationShader) { std::cout << "tessellationShader" << std::endl; }
-			if (PDF.multiViewport) { std::cout << "multiViewport" << std::endl; }
-
-			VkPhysicalDeviceMemoryProperties PDMP;
-			vkGetPhysicalDeviceMemoryProperties(i, &PDMP);
-			for (uint32_t i = 0; i < PDMP.memoryTypeCount; ++i) {
-				std::cout << "[" << i << "] HeapIndex = " << PDMP.memoryTypes[i].heapIndex << ", ";
-				std::cout << "PropertyFlags(" << PDMP.memoryTypes[i].propertyFlags << ") = ";
-				if (VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT & PDMP.memoryTypes[i].propertyFlags) { std::cout << "DEVICE_LOCAL | "; }
-				if (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT & PDMP.memoryTypes[i].propertyFlags) { std::cout << "HOST_VISIBLE | "; }
-				std::cout << std::endl;
-			}
-			for (uint32_t i = 0; i < PDMP.memoryHeapCount; ++i) {
-				std::cout << "Heap[" << i << "] Size = " << PDMP.memoryHeaps[i].size << ", ";
-				std::cout << "Flags = ";
-				if (VK_MEMORY_HEAP_DEVICE_LOCAL_BIT & PDMP.memoryHeaps[i].flags) { std::cout << "DEVICE_LOCAL | "; }
-				if (VK_MEMORY_HEAP_MULTI_INSTANCE_BIT_KHR & PDMP.memoryHeaps[i].flags) { std::cout << "MULTI_INSTANCE | "; }
-				std::cout << std::endl;
+		if (IsVerbose) {
+			for (const auto& i : PhysicalDevices) {
+				VkPhysicalDeviceProperties PDP;
+				vkGetPhysicalDeviceProperties(i, &PDP);
+				if (VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU == PDP.deviceType) { std::cout << "INTEGRATED_GPU" << std::endl; }
+				if (VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU == PDP.deviceType) { std::cout << "DISCRETE_GPU" << std::endl; }
+				std::cout << "maxUniformBufferRange = " << PDP.limits.maxUniformBufferRange << std::endl;
+				std::cout << "maxFragmentOutputAttachments = " << PDP.limits.maxFragmentOutputAttachments << std::endl;
+				std::cout << "maxColorAttachments = " << PDP.limits.maxColorAttachments << std::endl;
+
+				VkPhysicalDeviceFeatures PDF;
+				vkGetPhysicalDeviceFeatures(i, &PDF);
+				if (PDF.geometryShader) { std::cout << "geometryShader" << std::endl; }
+				if (PDF.tessellationShader) { std::cout << "tessellationShader" << std::endl; }
+				if (PDF.multiViewport) { std::cout << "multiViewport" << std::endl; }
+
+				VkPhysicalDeviceMemoryProperties PDMP;
+				vkGetPhysicalDeviceMemoryProperties(i, &PDMP);
+				for (uint32_t i = 0; i < PDMP.memoryTypeCount; ++i) {
+					std::cout << "[" << i << "] HeapIndex = " << PDMP.memoryTypes[i].heapIndex << ", ";
+					std::cout << "PropertyFlags(" << PDMP.memoryTypes[i].propertyFlags << ") = ";
+					if (VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT & PDMP.memoryTypes[i].propertyFlags) { std::cout << "DEVICE_LOCAL | "; }
+					if (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT & PDMP.memoryTypes[i].propertyFlags) { std::cout << "HOST_VISIBLE | "; }
+					std::cout << std::endl;
+				}
+				for (uint32_t i = 0; i < PDMP.memoryHeapCount; ++i) {
+					std::cout << "Heap[" << i << "] Size = " << PDMP.memoryHeaps[i].size << ", ";
+					std::cout << "Flags = ";
+					if (VK_MEMORY_HEAP_DEVICE_LOCAL_BIT & PDMP.memoryHeaps[i].flags) { std::cout << "DEVICE_LOCAL | "; }
+					if (VK_MEMORY_HEAP_MULTI_INSTANCE_BIT_KHR & PDMP.memoryHeaps[i].flags) { std::cout << "MULTI_INSTANCE | "; }
+					std::cout << std::endl;
+				}
 			}
 		}
 
@@ -258,7 +273,10 @@ int main()
 	VkDevice Device;
 	VkQueue GraphicsQueue;
 	VkQueue PresentQueue;
+	std::mutex QueueMutex;	//!< GraphicsQueue is used for both submit (render thread) and present (present thread)
+	auto IsMemoryBudgetSupported = false;
 	{
+		const Tracer::Scope Scope(Trace, "Device");
 		const auto& PD = PhysicalDevices[0];
 
 		std::vector<VkQueueFamilyProperties> QFPs;
@@ -304,7 +322,18 @@ int main()
 			}
 		}
 
-		const std::array<const char*, 1> Extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+		std::vector<const char*> Extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+		//!< Per heap usage for the HUD (needs vkGetPhysicalDeviceMemoryProperties2 of 1.1)
+		{
+			VERIFY_SUCCEEDED(vkEnumerateDeviceExtensionProperties(PD, nullptr, &Count, nullptr));
+			std::vector<VkExtensionProperties> EPs(Count);
+			VERIFY_SUCCEEDED(vkEnumerateDeviceExtensionProperties(PD, nullptr, &Count, EPs.data()));
+			VkPhysicalDeviceProperties PDP;
+			vkGetPhysicalDeviceProperties(PD, &PDP);
+			const auto Is11 = VK_API_VERSION_1_1 <= (std::min)(APIVersion, PDP.apiVersion);
+			IsMemoryBudgetSupported = Is11 && std::any_of(EPs.cbegin(), EPs.cend(), [](const VkExtensionProperties& rhs) { return !strcmp(rhs.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME); });
+			if (IsMemoryBudgetSupported) { Extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME); }
+		}
 		VkPhysicalDeviceFeatures PDF;
 		vkGetPhysicalDeviceFeatures(PD, &PDF);
 		const VkDeviceCreateInfo DCI = {
@@ -322,6 +351,22 @@ int main()
 		//vkGetDeviceQueue(Device, PresentQueueFamilyIndex, PresentQueueIndexInFamily, &PresentQueue);
 	}
 
+	//!< Shader modules (on a worker while the rest is set up)
+	std::vector<VkShaderModule> ShaderModules(2);
+	auto ShaderSetup = std::async(std::launch::async, [&]() {
+		const Tracer::Scope Scope(Trace, "ShaderModules");
+#ifdef EMBED_SPIRV
+		CreateShaderModule(&ShaderModules[0], Device, VS_SPV, sizeof(VS_SPV));
+		CreateShaderModule(&ShaderModules[1], Device, FS_SPV, sizeof(FS_SPV));
+#else
+		CreateShaderModule(&ShaderModules[0], Device, "VS.spv");
+		CreateShaderModule(&ShaderModules[1], Device, "FS.spv");
+#endif
+	});
+
+	//!< Deferred destruction (objects replaced at runtime are retired once their frame fence has signaled)
+	DeletionQueue PendingDeletions;
+
 	//!< Fence
 	VkFence Fence;
 	{
@@ -333,32 +378,19 @@ int main()
 		VERIFY_SUCCEEDED(vkCreateFence(Device, &FCI, GetAllocationCallbacks(), &Fence));
 	}
 
-	//!< Semaphore
-	VkSemaphore NextImageAcquiredSemaphore;
-	VkSemaphore RenderFinishedSemaphore;
-	{
-		const VkSemaphoreCreateInfo SCI = {
-			VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-			nullptr,
-			0
-		};
-		VERIFY_SUCCEEDED(vkCreateSemaphore(Device, &SCI, GetAllocationCallbacks(), &NextImageAcquiredSemaphore));
-		VERIFY_SUCCEEDED(vkCreateSemaphore(Device, &SCI, GetAllocationCallbacks(), &RenderFinishedSemaphore));
-	}
-
 	//!< Swapchain
 	VkSwapchainKHR Swapchain;
 	std::vector<VkImage> SwapchainImages;
 	std::vector<VkImageView> SwapchainImageViews;
 	{
+		const Tracer::Scope Scope(Trace, "Swapchain");
 		//const auto& PD = PhysicalDevices[0];
 		uint32_t Count = 0;
-#if 0
+		//!< One more image than double buffering by default, so that the present thread can acquire the next one while the previous is queued for display
 		VkSurfaceCapabilitiesKHR SC;
-		VERIFY_SUCCEEDED(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(PD, Surface, &SC));
-		const auto ImageCount = (std::min)(SC.minImageCount + 1, 0 == SC.maxImageCount ? 0xffff : SC.maxImageCount);
-		std::cout << SC.currentTransform << std::endl;
-#endif
+		VERIFY_SUCCEEDED(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(PhysicalDevices[0], Surface, &SC));
+		const auto ImageCount = (std::min)((std::max)(SwapchainImageCount, SC.minImageCount), 0 == SC.maxImageCount ? (std::numeric_limits<uint32_t>::max)() : SC.maxImageCount);
+		if (ImageCount != SwapchainImageCount) { std::cout << "Swapchain images = " << ImageCount << " (" << SwapchainImageCount << " is out of [" << SC.minImageCount << ", " << SC.maxImageCount << "])" << std::endl; }
 #if 0
 		VERIFY_SUCCEEDED(vkGetPhysicalDeviceSurfaceFormatsKHR(PD, Surface, &Count, nullptr));
 		std::vector<VkSurfaceFormatKHR> SFs(Count);
@@ -377,7 +409,7 @@ int main()
 			nullptr,
 			0,
 			Surface,
-			2/*3*/,
+			ImageCount,
 			VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
 			{ 1280, 720 },
 			1,
@@ -438,11 +470,10 @@ int main()
 	}
 
 	//!< Vertex data
-	using Vertex_PositionColor = struct Vertex_PositionColor { glm::vec3 Position; glm::vec4 Color; };
-	const std::array<Vertex_PositionColor, 3> Vertices = { {
-		{ { 0.0f, 0.5f, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } }, //!< CT
-		{ { -0.5f, -0.5f, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } }, //!< LB
-		{ { 0.5f, -0.5f, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } }, //!< RB
+	const std::array<Vertex_PositionColorTexcoord, 3> Vertices = { {
+		{ { 0.0f, 0.5f, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f }, { 0.5f, 0.0f } }, //!< CT
+		{ { -0.5f, -0.5f, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f }, { 0.0f, 1.0f } }, //!< LB
+		{ { 0.5f, -0.5f, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } }, //!< RB
 	} };
 
 	//!< Index data
@@ -488,68 +519,6 @@ int main()
 		CreateDeviceMemory(DeviceMemories, Device, MemoryRequirements);
 	}
 
-	//!< TODO
-	//!< Staging copy (create host visible memory, map and write to host visible memory, submit copy command to device local memory
-	if(0){
-		std::vector<VkBuffer> HostVisibleBuffers;
-		{
-			HostVisibleBuffers.resize(3);
-			{
-				const auto Stride = sizeof(Vertices[0]);
-				const auto Size = static_cast<VkDeviceSize>(Stride * Vertices.size());
-				CreateBuffer(&HostVisibleBuffers[0], Device, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, Size);
-			}
-			{
-				const auto Stride = sizeof(Indices[0]);
-				const auto Size = static_cast<VkDeviceSize>(Stride * IndexCount);
-				CreateBuffer(&HostVisibleBuffers[1], Device, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, Size);
-			}
-			{
-				const auto Stride = sizeof(DrawIndexedIndirectCommand);
-				const auto Size = static_cast<VkDeviceSize>(Stride * 1);
-				CreateBuffer(&HostVisibleBuffers[2], Device, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, Size);
-			}
-		}
-		std::vector<VkDeviceMemory> HostVisibleDeviceMemories;
-		std::vector<std::vector<VkMemoryRequirements>> HostVisibleMemoryRequirements;
-		{
-			const auto& PD = PhysicalDevices[0];
-			VkPhysicalDeviceMemoryProperties PDMP;
-			vkGetPhysicalDeviceMemoryProperties(PD, &PDMP);
-			HostVisibleMemoryRequirements.resize(PDMP.memoryTypeCount);
-			for (auto i : Buffers) {
-				VkMemoryRequirements MR;
-				vkGetBufferMemoryRequirements(Device, i, &MR);
-				HostVisibleMemoryRequirements[GetMemoryTypeIndex(PD, MR, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)].push_back(MR);
-			}
-			CreateDeviceMemory(HostVisibleDeviceMemories, Device, HostVisibleMemoryRequirements);
-		}
-		
-		//void* Data;
-		//VERIFY_SUCCEEDED(vkMapMemory(Device, DM, 0, Size, static_cast<VkMemoryMapFlags>(0), &Data)); {
-		//	memcpy(Data, Source, Size);
-		//	const std::array<VkMappedMemoryRange, 1> MMRs = {
-		//		{
-		//			VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
-		//			nullptr,
-		//			DM,
-		//			0,
-		//			VK_WHOLE_SIZE
-		//		}
-		//	};
-		//	VERIFY_SUCCEEDED(vkFlushMappedMemoryRanges(Device, static_cast<uint32_t>(MMRs.size()), MMRs.data()));
-		//} vkUnmapMemory(Device, DM);
-
-		for (auto i : HostVisibleDeviceMemories) {
-			if (VK_NULL_HANDLE != i) {
-				vkFreeMemory(Device, i, GetAllocationCallbacks());
-			}
-		}
-		for (auto i : HostVisibleBuffers) {
-			vkDestroyBuffer(Device, i, GetAllocationCallbacks());
-		}
-	}
-
 	//!< Bind buffers
 	{
 		const auto& PD = PhysicalDevices[0];
@@ -564,10 +533,68 @@ int main()
 		}
 	}
 
+	//!< Staging copy (device local buffers are not host visible, copy once through a host visible buffer)
+	{
+		const Tracer::Scope Scope(Trace, "Buffers");
+		StagingRing Staging(PhysicalDevices[0], Device, 64 * 1024);
+		const std::array<std::pair<const void*, VkDeviceSize>, 3> Sources = { {
+			{ Vertices.data(), sizeof(Vertices) },
+			{ Indices.data(), sizeof(Indices) },
+			{ &DrawIndexedIndirectCommand, sizeof(DrawIndexedIndirectCommand) },
+		} };
+		const std::array<VkBufferUsageFlags, 3> Usages = { VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT };
+		for (size_t i = 0; i < Sources.size(); ++i) {
+			Capture.AddBuffer(Buffers[i], Usages[i], Sources[i].first, Sources[i].second);
+		}
+
+		const auto CB = CommandBuffers[0];
+		const VkCommandBufferBeginInfo CBBI = {
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			nullptr,
+			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			nullptr
+		};
+		VERIFY_SUCCEEDED(vkBeginCommandBuffer(CB, &CBBI)); {
+			std::array<VkBufferMemoryBarrier, 3> BMBs;
+			for (size_t i = 0; i < Sources.size(); ++i) {
+				VkDeviceSize Offset = 0;
+				const auto Written = Staging.Write(Sources[i].first, Sources[i].second, 16, 0, Offset);
+				assert(Written && "Staging buffer too small"); (void)Written;
+				const std::array<VkBufferCopy, 1> BCs = { { { Offset, 0, Sources[i].second } } };
+				vkCmdCopyBuffer(CB, Staging.GetBuffer(), Buffers[i], static_cast<uint32_t>(BCs.size()), BCs.data());
+				BMBs[i] = {
+					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+					nullptr,
+					VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+					VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+					Buffers[i], 0, VK_WHOLE_SIZE
+				};
+			}
+			vkCmdPipelineBarrier(CB, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, static_cast<uint32_t>(BMBs.size()), BMBs.data(), 0, nullptr);
+		} VERIFY_SUCCEEDED(vkEndCommandBuffer(CB));
+
+		const std::array<VkSubmitInfo, 1> SIs = { {
+			{ VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr, 0, nullptr, nullptr, 1, &CB, 0, nullptr }
+		} };
+		VERIFY_SUCCEEDED(vkQueueSubmit(GraphicsQueue, static_cast<uint32_t>(SIs.size()), SIs.data(), VK_NULL_HANDLE));
+		VERIFY_SUCCEEDED(vkQueueWaitIdle(GraphicsQueue));
+	}
+
+	//!< Textures
+	std::unique_ptr<TextureManager> Textures;
+	uint32_t CheckerTexture;
+	{
+		const Tracer::Scope Scope(Trace, "Textures");
+		Textures.reset(new TextureManager(PhysicalDevices[0], Device, PendingDeletions, 8, 16 * 1024 * 1024, 1024 * 1024));
+		//!< Offline compressed (ETC2 / ASTC) KTX if present and supported, procedural RGBA8 otherwise
+		CheckerTexture = Textures->Register("Checker.ktx", CreateCheckerRGBA8(256, 256, 32, { 0xff, 0xff, 0xff, 0xff }, { 0x40, 0x40, 0x40, 0xff }));
+		Capture.AddTexture(CheckerTexture, Textures->GetSource(CheckerTexture));
+	}
+
 	//!< Pipeline layout
 	VkPipelineLayout PipelineLayout;
 	{
-		const std::array<VkDescriptorSetLayout, 0> DSLs = {};
+		const std::array<VkDescriptorSetLayout, 1> DSLs = { Textures->GetDescriptorSetLayout() };
 		const std::array<VkPushConstantRange, 0> PCRs = {};
 		const VkPipelineLayoutCreateInfo PLCI = {
 			VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
@@ -582,6 +609,7 @@ int main()
 	//!< Render pass
 	VkRenderPass RenderPass;
 	{
+		const Tracer::Scope Scope(Trace, "RenderPass");
 		const std::array<VkAttachmentDescription, 1> ADs = {
 			0,
 			VK_FORMAT_B8G8R8A8_UNORM,
@@ -602,7 +630,15 @@ int main()
 			nullptr,
 			static_cast<uint32_t>(Preserve.size()), Preserve.data()
 		};
-		const std::array<VkSubpassDependency, 0> SDeps = {};
+		//!< The submit waits for the acquired image at COLOR_ATTACHMENT_OUTPUT, the layout transition has to wait there too
+		const std::array<VkSubpassDependency, 1> SDeps = { {
+			{
+				VK_SUBPASS_EXTERNAL, 0,
+				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				0, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				0
+			},
+		} };
 		const VkRenderPassCreateInfo RPCI = {
 			VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
 			nullptr,
@@ -614,148 +650,66 @@ int main()
 		VERIFY_SUCCEEDED(vkCreateRenderPass(Device, &RPCI, GetAllocationCallbacks(), &RenderPass));
 	}
 
-	//!< Shader moudles
-	std::vector<VkShaderModule> ShaderModules;
-	{
-		ShaderModules.resize(2);
-		CreateShaderModule(&ShaderModules[0], Device, "VS.spv");
-		CreateShaderModule(&ShaderModules[1], Device, "FS.spv");
-	}
-
-	//!< Pipeline
-	VkPipeline Pipeline;
+	//!< Pipeline (the default and HUD ones are built on the pool while the HUD and framebuffers are set up, the other permutations after the first present)
+	PipelineCacheObject PipelineCache;
+	std::unique_ptr<PipelineFactory> Pipelines;
+	std::unique_ptr<ThreadPool> Pool(new ThreadPool());
+	std::future<void> PipelineBuild;
+	uint32_t PipelineIndex, HudPipelineIndex;
 	{
-		const std::array<VkPipelineShaderStageCreateInfo, 2> PSSCIs = {
-			VkPipelineShaderStageCreateInfo({ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_VERTEX_BIT, ShaderModules[0], "main", nullptr }),
-			VkPipelineShaderStageCreateInfo({ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_FRAGMENT_BIT, ShaderModules[1], "main", nullptr }),
-		};
-
-		const uint32_t Binding = 0;
-		const std::array<VkVertexInputBindingDescription, 1> VIBDs = { {
-			{ Binding, sizeof(Vertex_PositionColor), VK_VERTEX_INPUT_RATE_VERTEX },
-		} };
-		const std::array<VkVertexInputAttributeDescription, 2> VIADs = { {
-			{ 0, Binding, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex_PositionColor, Position) },
-			{ 1, Binding, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Vertex_PositionColor, Color) },
-		} };
-		const VkPipelineVertexInputStateCreateInfo PVISCI = {
-			VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-			nullptr,
-			0,
-			static_cast<uint32_t>(VIBDs.size()), VIBDs.data(),
-			static_cast<uint32_t>(VIADs.size()), VIADs.data()
-		};
-
-		const VkPipelineInputAssemblyStateCreateInfo PIASCI = {
-			VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-			nullptr,
-			0,
-			VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
-			VK_FALSE
-		};
-
-		const VkPipelineTessellationStateCreateInfo PTSCI = {
-			VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO,
-			nullptr,
-			0,
-			0
-		};
-
-		const VkPipelineViewportStateCreateInfo PVSCI = {
-			VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-			nullptr,
-			0,
-			1, nullptr,
-			1, nullptr
-		};
-
-		const VkPipelineRasterizationStateCreateInfo PRSCI = {
-			VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-			nullptr,
-			0,
-			VK_FALSE,
-			VK_FALSE,
-			VK_POLYGON_MODE_FILL,
-			VK_CULL_MODE_BACK_BIT,
-			VK_FRONT_FACE_COUNTER_CLOCKWISE,
-			VK_FALSE, 0.0f, 0.0f, 0.0f,
-			1.0f
-		};
-
-		const VkPipelineMultisampleStateCreateInfo PMSCI = {
-			VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-			nullptr,
-			0,
-			VK_SAMPLE_COUNT_1_BIT,
-			VK_FALSE, 0.0f,
-			nullptr,
-			VK_FALSE, VK_FALSE
-		};
-
-		const VkPipelineDepthStencilStateCreateInfo PDSSCI = {
-			VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+		const VkPipelineCacheCreateInfo PCCI = {
+			VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
 			nullptr,
 			0,
-			VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL,
-			VK_FALSE,
-			VK_FALSE, { VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP, VK_COMPARE_OP_NEVER, 0, 0, 0 }, { VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP, VK_COMPARE_OP_ALWAYS, 0, 0, 0 },
-			0.0f, 1.0f
+			0, nullptr
 		};
+		VERIFY_SUCCEEDED(vkCreatePipelineCache(Device, &PCCI, GetAllocationCallbacks(), PipelineCache.Put(Device)));
+
+		const auto ThreadCount = Pool->GetWorkerCount() + 1;
+		ShaderSetup.get();
+#ifdef EMBED_SPIRV
+		Capture.AddShader(VK_SHADER_STAGE_VERTEX_BIT, VS_SPV, sizeof(VS_SPV));
+		Capture.AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, FS_SPV, sizeof(FS_SPV));
+#else
+		Capture.AddShader(VK_SHADER_STAGE_VERTEX_BIT, "VS.spv");
+		Capture.AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, "FS.spv");
+#endif
 
-		const std::array<VkPipelineColorBlendAttachmentState, 1> PCBASs = {
-			{
-				VK_FALSE,
-				VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ONE, VK_BLEND_OP_ADD,
-				VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ONE, VK_BLEND_OP_ADD,
-				VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-			},
-		};
-		const VkPipelineColorBlendStateCreateInfo PCBSCI = {
-			VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-			nullptr,
-			0,
-			VK_FALSE, VK_LOGIC_OP_COPY,
-			static_cast<uint32_t>(PCBASs.size()), PCBASs.data(),
-			{ 1.0f, 1.0f, 1.0f, 1.0f }
-		};
+		//!< Build time of every permutation from 1 thread up to all cores, each run starts from an empty cache
+		if (IsPipelineBench) {
+			for (uint32_t i = 1; i <= ThreadCount; ++i) {
+				PipelineCacheObject PC;
+				VERIFY_SUCCEEDED(vkCreatePipelineCache(Device, &PCCI, GetAllocationCallbacks(), PC.Put(Device)));
+				PipelineFactory PF(Device, PC, PipelineLayout, RenderPass, ShaderModules[0], ShaderModules[1]);
+				for (const auto& j : PipelineFactory::EnumeratePermutations()) { PF.Add(j); }
+				const auto Elapsed = PF.Build(*Pool, i);
+				std::cout << "PipelineBench : Threads = " << i << ", Pipelines = " << PF.GetCount() << ", Time = " << Elapsed << " msec" << std::endl;
+			}
+		}
 
-		const std::array<VkDynamicState, 2> DSs = {
-			VK_DYNAMIC_STATE_VIEWPORT,
-			VK_DYNAMIC_STATE_SCISSOR,
-		};
-		const VkPipelineDynamicStateCreateInfo PDSCI = {
-			VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-			nullptr,
-			0,
-			static_cast<uint32_t>(DSs.size()), DSs.data()
-		};
+		//!< Default state (index 0) is the base pipeline used for drawing, the others derive from it
+		Pipelines.reset(new PipelineFactory(Device, PipelineCache, PipelineLayout, RenderPass, ShaderModules[0], ShaderModules[1]));
+		PipelineIndex = Pipelines->Add(PipelineState());
+		HudPipelineIndex = Pipelines->Add(Hud::GetPipelineState());
+		for (const auto& i : PipelineFactory::EnumeratePermutations()) { Pipelines->Add(i); }
+		const auto FirstFrameCount = static_cast<size_t>((std::max)(PipelineIndex, HudPipelineIndex)) + 1;
+		PipelineBuild = std::async(std::launch::async, [&, ThreadCount, FirstFrameCount]() {
+			const Tracer::Scope Scope(Trace, "Pipelines");
+			Pipelines->Build(*Pool, ThreadCount, FirstFrameCount);
+		});
+	}
 
-		const std::array<VkGraphicsPipelineCreateInfo, 1> GPCIs = {
-			{
-				VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-				nullptr,
-				0,
-				static_cast<uint32_t>(PSSCIs.size()), PSSCIs.data(),
-				&PVISCI,
-				&PIASCI,
-				&PTSCI,
-				&PVSCI,
-				&PRSCI,
-				&PMSCI,
-				&PDSSCI,
-				&PCBSCI,
-				&PDSCI,
-				PipelineLayout,
-				RenderPass, 0, 
-				VK_NULL_HANDLE, -1
-			}
-		};
-		VERIFY_SUCCEEDED(vkCreateGraphicsPipelines(Device, VK_NULL_HANDLE, static_cast<uint32_t>(GPCIs.size()), GPCIs.data(), GetAllocationCallbacks(), &Pipeline));
+	//!< HUD (toggled with F1)
+	std::unique_ptr<Hud> Overlay;
+	{
+		const Tracer::Scope Scope(Trace, "Hud");
+		Overlay.reset(new Hud(PhysicalDevices[0], Device, GraphicsQueueFamilyIndex, *Textures, 1280, 720, IsMemoryBudgetSupported));
 	}
 
 	//!< Framebuffer
 	std::vector<VkFramebuffer> Framebuffers(SwapchainImageViews.size());
 	{
+		const Tracer::Scope Scope(Trace, "Framebuffer");
 		for (size_t i = 0; i < SwapchainImageViews.size(); ++i) {
 			Framebuffers.push_back(VkFramebuffer());
 			const std::array<VkImageView, 1> IVs = { SwapchainImageViews[i] };
@@ -772,111 +726,195 @@ int main()
 		}
 	}
 
-	//!< Populate command
-	{
-		for (size_t i = 0; i < CommandBuffers.size(); ++i) {
-			const auto CB = CommandBuffers[i];
-			const VkCommandBufferBeginInfo CBBI = {
-				VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+	//!< Needed from the first command on
+	PipelineBuild.get();
+	const auto Pipeline = Pipelines->Get(PipelineIndex);
+	const auto HudPipeline = Pipelines->Get(HudPipelineIndex);
+	Capture.AddPipeline(Pipeline, Pipelines->GetState(PipelineIndex));
+
+	//!< Populate command (re-recorded every frame, texture uploads are recorded ahead of the render pass)
+	//!< Commands of the scene go through Capture, the HUD is not part of the captured frames
+	const auto PopulateCommandBuffer = [&](const uint32_t i) {
+		const auto CB = CommandBuffers[i];
+		const VkCommandBufferBeginInfo CBBI = {
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			nullptr,
+			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			nullptr
+		};
+		Capture.BeginFrame();
+		VERIFY_SUCCEEDED(vkBeginCommandBuffer(CB, &CBBI)); {
+			Overlay->BeginCommand(CB);
+
+			Textures->Touch(CheckerTexture);
+			Textures->Update(CB);
+			Overlay->EndPass(CB, Hud::PASS::UPLOAD);
+
+			const std::array<VkClearValue, 1> CVs = { ClearValue };
+			const VkRect2D RenderArea = { { 0, 0 }, { 1280, 720 } };
+			const VkRenderPassBeginInfo RPBI = {
+				VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
 				nullptr,
-				0,
-				nullptr
+				RenderPass,
+				Framebuffers[i],
+				RenderArea,
+				static_cast<uint32_t>(CVs.size()), CVs.data()
 			};
-			VERIFY_SUCCEEDED(vkBeginCommandBuffer(CB, &CBBI)); {
-				const std::array<VkClearValue, 1> CVs = { { 0.529411793f, 0.807843208f, 0.921568692f, 1.0f } };
-				const VkRect2D RenderArea = { { 0, 0 }, { 1280, 720 } };
-				const VkRenderPassBeginInfo RPBI = {
-					VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-					nullptr,
-					RenderPass,
-					Framebuffers[i],
-					RenderArea,
-					static_cast<uint32_t>(CVs.size()), CVs.data()
-				};
-				vkCmdBeginRenderPass(CB, &RPBI, VK_SUBPASS_CONTENTS_INLINE); {
-					const std::array<VkViewport, 1> Viewports = { { 0.0f, 720.0f, 1280.0f, -720.0f, 0.0f, 1.0f } };
-					const std::array<VkRect2D, 1> ScissorRects = { {{{ 0, 0 }, { 1280, 720 }}} };
-					vkCmdSetViewport(CB, 0, static_cast<uint32_t>(Viewports.size()), Viewports.data());
-					vkCmdSetScissor(CB, 0, static_cast<uint32_t>(ScissorRects.size()), ScissorRects.data());
-
-					vkCmdBindPipeline(CB, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline);
-
-					const std::array<VkBuffer, 1> VBs = { Buffers[0] };
-					const std::array<VkDeviceSize, 1> Offsets = { 0 };
-					vkCmdBindVertexBuffers(CB, 0, static_cast<uint32_t>(VBs.size()), VBs.data(), Offsets.data());
-					const auto IB = Buffers[1];
-					vkCmdBindIndexBuffer(CB, IB, 0, VK_INDEX_TYPE_UINT32);
-					const auto IDB = Buffers[2];
-					vkCmdDrawIndexedIndirect(CB, IDB, 0, 1, 0);
-				} vkCmdEndRenderPass(CB);
-			} VERIFY_SUCCEEDED(vkEndCommandBuffer(CB));
-		}
-	}
+			vkCmdBeginRenderPass(CB, &RPBI, VK_SUBPASS_CONTENTS_INLINE); {
+				Capture.CmdSetViewport(CB, { 0.0f, 720.0f, 1280.0f, -720.0f, 0.0f, 1.0f });
+				Capture.CmdSetScissor(CB, { { 0, 0 }, { 1280, 720 } });
+
+				Capture.CmdBindPipeline(CB, Pipeline);
+
+				Capture.CmdBindTexture(CB, PipelineLayout, CheckerTexture, Textures->GetDescriptorSet(CheckerTexture));
+
+				Capture.CmdBindVertexBuffer(CB, Buffers[0], 0);
+				const auto IB = Buffers[1];
+				Capture.CmdBindIndexBuffer(CB, IB, 0, VK_INDEX_TYPE_UINT32);
+				const auto IDB = Buffers[2];
+				Capture.CmdDrawIndexedIndirect(CB, IDB, 0, 1, 0);
+				Overlay->AddDraws(1);
+				Overlay->EndPass(CB, Hud::PASS::MAIN);
+
+				//!< Overlay last, on top of everything
+				Overlay->Draw(CB, HudPipeline, PipelineLayout);
+				Overlay->EndPass(CB, Hud::PASS::OVERLAY);
+			} vkCmdEndRenderPass(CB);
+		} VERIFY_SUCCEEDED(vkEndCommandBuffer(CB));
+		Capture.EndFrame();
+	};
+
+	//!< Input thread
+	InputThread Input;
+	InputLatency Latency;
+	Input.Start(Connection, Window);
+
+	//!< Present thread
+	std::unique_ptr<PresentThread> Presenter(new PresentThread(Device, Swapchain, GraphicsQueue, QueueMutex, static_cast<uint32_t>(SwapchainImages.size()), !IsSyncPresent));
+	Presenter->SetOnFirstPresent([&]() {
+		Trace.Instant("FirstFrame");
+		//!< Until vkQueuePresentKHR of the first frame returned, not yet measured against the 100 msec target on a Pi
+		std::cout << "TimeToFirstFrame = " << Trace.GetElapsedMS() << " msec" << std::endl;
+		if (IsVerbose) { Trace.Print(std::cout); }
+		if (!TracePath.empty() && Trace.Write(TracePath)) { std::cout << "Trace written to " << TracePath << std::endl; }
+	});
 
 	//!< Loop
 	uint32_t SwapchainImageIndex = 0;
 	{
 		auto LoopEnd = false;
-		xcb_generic_event_t* Event;
-		while (!LoopEnd && (Event = xcb_wait_for_event(Connection))) {
-			switch (Event->response_type & ~0x80) {
-			default:
+		auto IsFirstFrame = true;
+		while (!LoopEnd) {
+			//!< Never blocks on the X server, events are queued by the input thread
+			InputEvent IE;
+			while (Input.Pop(IE)) {
+				Latency.Add(IE);
+				switch (IE.Type) {
+				case InputEvent::TYPE::KEY_PRESS:
+					switch (IE.Detail) {
+					case InputEvent::KEYCODE_ESCAPE: LoopEnd = true; break;
+					case InputEvent::KEYCODE_F1: Overlay->Toggle(); break;
+					default: break;
+					}
+					break;
+				default: break;
+				}
+			}
+			if (LoopEnd || Input.IsQuitRequested()) { break; }
+
+			const std::array<VkFence, 1> Fences = { Fence };
+			VERIFY_SUCCEEDED(vkWaitForFences(Device, static_cast<uint32_t>(Fences.size()), Fences.data(), VK_TRUE, (std::numeric_limits<uint64_t>::max)()));
+			vkResetFences(Device, static_cast<uint32_t>(Fences.size()), Fences.data());
+
+			//!< Single fence : once it has signaled every submission before this frame is done
+			PendingDeletions.BeginFrame();
+			PendingDeletions.Collect(PendingDeletions.GetFrame() - 1);
+			Overlay->BeginFrame();
+
+			//!< Usually already acquired by the present thread while this thread waited for the fence
+			VkSemaphore NextImageAcquiredSemaphore, RenderFinishedSemaphore;
+			SwapchainImageIndex = Presenter->Acquire(NextImageAcquiredSemaphore, RenderFinishedSemaphore);
+			PopulateCommandBuffer(SwapchainImageIndex);
+
+			const std::vector<VkSemaphore> WaitSem = { NextImageAcquiredSemaphore };
+			//!< Only writing the swapchain image has to wait, texture uploads ahead of the render pass do not
+			const std::vector<VkPipelineStageFlags> WaitPS = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+			assert(WaitSem.size() == WaitPS.size() && "Must be same size()");
+			//!< sR}hobt@
+			const std::vector<VkCommandBuffer> CBs = { CommandBuffers[SwapchainImageIndex], };
+			//!< `抮ɃVOiZ}tH
+			const std::vector<VkSemaphore> SigSem = { RenderFinishedSemaphore };
+			const std::vector<VkSubmitInfo> SIs = {
+				{
+					VK_STRUCTURE_TYPE_SUBMIT_INFO,
+					nullptr,
+					static_cast<uint32_t>(WaitSem.size()), WaitSem.data(), WaitPS.data(), //!< C[W擾ł(v[g)܂ŃEGCg
+					static_cast<uint32_t>(CBs.size()), CBs.data(),
+					static_cast<uint32_t>(SigSem.size()), SigSem.data() //!< `抮ʒm
+				},
+			};
 			{
-				const std::array<VkFence, 1> Fences = { Fence };
-				VERIFY_SUCCEEDED(vkWaitForFences(Device, static_cast<uint32_t>(Fences.size()), Fences.data(), VK_TRUE, (std::numeric_limits<uint64_t>::max)()));
-				vkResetFences(Device, static_cast<uint32_t>(Fences.size()), Fences.data());
-
-				VERIFY_SUCCEEDED(vkAcquireNextImageKHR(Device, Swapchain, UINT64_MAX, NextImageAcquiredSemaphore, VK_NULL_HANDLE, &SwapchainImageIndex));
-
-				const std::vector<VkSemaphore> WaitSem = { NextImageAcquiredSemaphore };
-				const std::vector<VkPipelineStageFlags> WaitPS = { VK_PIPELINE_STAGE_TRANSFER_BIT };
-				assert(WaitSem.size() == WaitPS.size() && "Must be same size()");
-				//!< sR}hobt@
-				const std::vector<VkCommandBuffer> CBs = { CommandBuffers[SwapchainImageIndex], };
-				//!< `抮ɃVOiZ}tH
-				const std::vector<VkSemaphore> SigSem = { RenderFinishedSemaphore };
-				const std::vector<VkSubmitInfo> SIs = {
-					{
-						VK_STRUCTURE_TYPE_SUBMIT_INFO,
-						nullptr,
-						static_cast<uint32_t>(WaitSem.size()), WaitSem.data(), WaitPS.data(), //!< C[W擾ł(v[g)܂ŃEGCg
-						static_cast<uint32_t>(CBs.size()), CBs.data(),
-						static_cast<uint32_t>(SigSem.size()), SigSem.data() //!< `抮ʒm
-					},
-				};
+				std::lock_guard<std::mutex> Lock(QueueMutex);
 				VERIFY_SUCCEEDED(vkQueueSubmit(GraphicsQueue, static_cast<uint32_t>(SIs.size()), SIs.data(), Fence));
-
-				//!< Present
-				{
-					const std::vector<VkSwapchainKHR> Swapchains = { Swapchain };
-					const std::vector<uint32_t> ImageIndices = { SwapchainImageIndex };
-					assert(Swapchains.size() == ImageIndices.size() && "Must be same");
-					//!< Tu~bgɎw肵Z}tH(RenderFinishedSemaphore)҂Ăv[gsȂ
-					const VkPresentInfoKHR PresentInfo = {
-						VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-						nullptr,
-						1, &RenderFinishedSemaphore,
-						static_cast<uint32_t>(Swapchains.size()), Swapchains.data(), ImageIndices.data(),
-						nullptr
-					};
-					//VERIFY_SUCCEEDED(vkQueuePresentKHR(PresentQueue, &PresentInfo)); #TODO
-					VERIFY_SUCCEEDED(vkQueuePresentKHR(GraphicsQueue, &PresentInfo));
-				}
-				std::this_thread::sleep_for(std::chrono::milliseconds(16));
 			}
-			break;
-			case XCB_KEY_PRESS: LoopEnd = true; break;
+
+			//!< Present (the present thread then acquires the next image while this thread moves on to the next frame)
+			Presenter->Present(SwapchainImageIndex);
+
+			if (IsFirstFrame) {
+				IsFirstFrame = false;
+				//!< Only queued for the present thread when threaded, TimeToFirstFrame is taken once it has actually been presented
+				Trace.Instant("FirstSubmit");
+
+				//!< Nothing drawn so far needs the rest of the permutations, they are looked up by index once built
+				const auto ThreadCount = Pool->GetWorkerCount() + 1;
+				PipelineBuild = std::async(std::launch::async, [&, ThreadCount]() {
+					const Tracer::Scope Scope(Trace, "PipelinePermutations");
+					const auto Elapsed = Pipelines->Build(*Pool, ThreadCount);
+					std::cout << "Pipelines = " << Pipelines->GetCount() << " (Duplicates = " << Pipelines->GetDuplicateCount() << "), Threads = " << ThreadCount << ", Time = " << Elapsed << " msec" << std::endl;
+				});
 			}
-			free(Event);
 		}
 	}
+	Input.Stop();
+	Presenter->Stop();
+	{
+		//!< Render thread blocked in acquire / present, compare with --sync-present
+		const auto& PS = Presenter->GetStats();
+		std::cout << "Present : " << (Presenter->GetIsThreaded() ? "Threaded" : "Sync") << ", Frames = " << PS.Present.Count
+			<< ", Blocked in Acquire Avg = " << PS.Acquire.GetAverageMS() << " msec (Max = " << PS.Acquire.GetMaxMS() << ")"
+			<< ", in Present Avg = " << PS.Present.GetAverageMS() << " msec (Max = " << PS.Present.GetMaxMS() << ")" << std::endl;
+		if (Presenter->GetIsThreaded()) {
+			const auto& TS = Presenter->GetThreadStats();
+			std::cout << "\tPresent thread : Acquire Avg = " << TS.Acquire.GetAverageMS() << " msec, Present Avg = " << TS.Present.GetAverageMS() << " msec" << std::endl;
+		}
+	}
+	if (!CapturePath.empty()) {
+		std::cout << "Capture : Frames = " << Capture.GetFrameCount() << ", Size = " << Capture.GetWrittenBytes() / 1024 << " KB (" << CapturePath << ")" << std::endl;
+		Capture.Close();
+	}
+	std::cout << "Input : Events = " << Latency.Count << ", Latency Avg = " << Latency.GetAverageMS() << " msec, Max = " << Latency.GetMaxMS() << " msec, Dropped = " << Input.GetDroppedCount() << std::endl;
 
 	//!< Destruct
 	{
+		if (PipelineBuild.valid()) { PipelineBuild.get(); }
+		Pool.reset();
+		VERIFY_SUCCEEDED(vkDeviceWaitIdle(Device));
+		{
+			const auto& TS = Textures->GetStats();
+			std::cout << "Texture : Resident = " << TS.ResidentCount << " (" << TS.ResidentBytes / 1024 << " KB), Uploaded = " << TS.UploadedBytes / 1024 << " KB, Throughput = " << TS.GetThroughputMBps() << " MB/s, Evictions = " << TS.Evictions << ", Failures = " << TS.ResidentFailures << std::endl;
+		}
+		Overlay.reset();
+		Textures.reset();
+		Presenter.reset();
+		PendingDeletions.Flush();
+		std::cout << "DeletionQueue : Frames = " << PendingDeletions.GetFrame() << ", Retired = " << PendingDeletions.GetTotalRetired() << std::endl;
+
 		for (auto i : Framebuffers) {
 			vkDestroyFramebuffer(Device, i, GetAllocationCallbacks());
 		}
-		vkDestroyPipeline(Device, Pipeline, GetAllocationCallbacks());
+		Pipelines.reset();
+		PipelineCache.Reset();
 		for (auto i : ShaderModules) {
 			vkDestroyShaderModule(Device, i, GetAllocationCallbacks());
 		}
@@ -893,8 +931,6 @@ int main()
 		vkFreeCommandBuffers(Device, CommandPool, static_cast<uint32_t>(CommandBuffers.size()), CommandBuffers.data());
 		vkDestroyCommandPool(Device, CommandPool, GetAllocationCallbacks());
 		vkDestroySwapchainKHR(Device, Swapchain, GetAllocationCallbacks());
-		vkDestroySemaphore(Device, NextImageAcquiredSemaphore, GetAllocationCallbacks());
-		vkDestroySemaphore(Device, RenderFinishedSemaphore, GetAllocationCallbacks());
 		vkDestroyFence(Device, Fence, GetAllocationCallbacks());
 		vkDestroyDevice(Device, GetAllocationCallbacks());
 		vkDestroySurfaceKHR(Instance, Surface, GetAllocationCallbacks());
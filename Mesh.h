@@ -0,0 +1,324 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <string>
+#include <fstream>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "Common.h"
+#include "PipelineFactory.h"
+
+//!< Detail level, a range of Mesh::Indices drawn with the shared vertices
+struct MeshLOD
+{
+	uint32_t FirstIndex;
+	uint32_t IndexCount;
+	float Error;			//!< Upper bound of how far the surface moved from level 0, in mesh units
+};
+
+//!< Level 0 is the full mesh, every further level roughly halves the triangles
+//!< Levels only differ in their indices (collapses move vertices onto existing ones), so one vertex buffer and one index buffer hold the whole chain
+struct Mesh
+{
+	std::vector<Vertex_PositionColorTexcoord> Vertices;
+	std::vector<uint32_t> Indices;
+	std::vector<MeshLOD> LODs;
+	float Radius = 0.0f;	//!< Bounding sphere around the origin
+};
+
+//!< Closed UV sphere with a bumpy radius, so that simplification has something to lose
+//!< Slices wrap around without a seam vertex and the poles are single vertices, which keeps the mesh manifold
+inline Mesh CreateBumpySphere(const uint32_t Slices, const uint32_t Stacks, const float Bump)
+{
+	const auto Pi = 3.14159265f;
+	Mesh M;
+	const auto Add = [&](const float Theta, const float Phi) {
+		const auto R = 1.0f + Bump * std::sin(6.0f * Phi) * std::sin(4.0f * Theta);
+		const glm::vec3 N = { std::sin(Theta) * std::cos(Phi), std::cos(Theta), std::sin(Theta) * std::sin(Phi) };
+		M.Vertices.push_back({ N * R, glm::vec4(N * 0.5f + 0.5f, 1.0f), { Phi / (2.0f * Pi), Theta / Pi } });
+		M.Radius = (std::max)(M.Radius, R);
+	};
+	Add(0.0f, 0.0f);
+	for (uint32_t i = 1; i < Stacks; ++i) {
+		for (uint32_t j = 0; j < Slices; ++j) {
+			Add(Pi * i / Stacks, 2.0f * Pi * j / Slices);
+		}
+	}
+	Add(Pi, 0.0f);
+
+	const auto South = static_cast<uint32_t>(M.Vertices.size() - 1);
+	const auto Ring = [&](const uint32_t Stack, const uint32_t Slice) { return 1 + (Stack - 1) * Slices + Slice % Slices; };
+	const auto Triangle = [&](const uint32_t i0, const uint32_t i1, const uint32_t i2) {
+		//!< Outward facing counter clockwise
+		const auto& P0 = M.Vertices[i0].Position;
+		const auto N = glm::cross(M.Vertices[i1].Position - P0, M.Vertices[i2].Position - P0);
+		if (glm::dot(N, P0 + M.Vertices[i1].Position + M.Vertices[i2].Position) >= 0.0f) {
+			M.Indices.insert(M.Indices.end(), { i0, i1, i2 });
+		} else {
+			M.Indices.insert(M.Indices.end(), { i0, i2, i1 });
+		}
+	};
+	for (uint32_t j = 0; j < Slices; ++j) {
+		Triangle(0, Ring(1, j), Ring(1, j + 1));
+		Triangle(South, Ring(Stacks - 1, j + 1), Ring(Stacks - 1, j));
+	}
+	for (uint32_t i = 1; i + 1 < Stacks; ++i) {
+		for (uint32_t j = 0; j < Slices; ++j) {
+			Triangle(Ring(i, j), Ring(i + 1, j), Ring(i + 1, j + 1));
+			Triangle(Ring(i, j), Ring(i + 1, j + 1), Ring(i, j + 1));
+		}
+	}
+	M.LODs.push_back({ 0, static_cast<uint32_t>(M.Indices.size()), 0.0f });
+	return M;
+}
+
+//!< Box around the bounding sphere, the proxy drawn by occlusion queries (with culling disabled)
+inline Mesh CreateBoundingBox(const float Radius)
+{
+	Mesh M;
+	for (uint32_t i = 0; i < 8; ++i) {
+		M.Vertices.push_back({ { i & 1 ? Radius : -Radius, i & 2 ? Radius : -Radius, i & 4 ? Radius : -Radius }, { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f } });
+	}
+	M.Indices = { 0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5 };
+	M.LODs.push_back({ 0, static_cast<uint32_t>(M.Indices.size()), 0.0f });
+	M.Radius = Radius * std::sqrt(3.0f);
+	return M;
+}
+
+//!< Edge collapse with quadric error metrics, every vertex collapses onto one of its neighbours (half edge collapse)
+//!< Each pass collapses the cheapest edges whose neighbourhoods do not overlap, rejecting collapses that flip a triangle
+//!< Boundary vertices stay where they are so open meshes keep their outline
+//!< Returns indices with at most about TargetIndexCount entries, Error is the square root of the largest quadric cost (summed over passes)
+inline std::vector<uint32_t> Simplify(const std::vector<Vertex_PositionColorTexcoord>& Vertices, const std::vector<uint32_t>& Indices, const size_t TargetIndexCount, float& Error)
+{
+	using Quadric = std::array<double, 10>;
+	const auto Evaluate = [](const Quadric& Q, const glm::vec3& V) {
+		const double x = V.x, y = V.y, z = V.z;
+		return Q[0] * x * x + 2.0 * Q[1] * x * y + 2.0 * Q[2] * x * z + 2.0 * Q[3] * x
+			+ Q[4] * y * y + 2.0 * Q[5] * y * z + 2.0 * Q[6] * y
+			+ Q[7] * z * z + 2.0 * Q[8] * z
+			+ Q[9];
+	};
+	const auto EdgeKey = [](const uint32_t a, const uint32_t b) { return (static_cast<uint64_t>((std::min)(a, b)) << 32) | (std::max)(a, b); };
+
+	Error = 0.0f;
+	std::vector<uint32_t> Result = Indices;
+	std::vector<uint32_t> Remap(Vertices.size());
+	while (Result.size() > TargetIndexCount) {
+		const auto TriangleCount = Result.size() / 3;
+
+		//!< Plane quadrics of the current triangles
+		std::vector<Quadric> Qs(Vertices.size(), Quadric());
+		std::vector<std::vector<uint32_t>> VertexTriangles(Vertices.size());
+		std::unordered_map<uint64_t, uint32_t> EdgeUse;
+		for (size_t t = 0; t < TriangleCount; ++t) {
+			const auto* Tri = &Result[t * 3];
+			const auto& P0 = Vertices[Tri[0]].Position;
+			const auto C = glm::cross(Vertices[Tri[1]].Position - P0, Vertices[Tri[2]].Position - P0);
+			const auto Len = glm::length(C);
+			if (Len > 0.0f) {
+				const auto N = C / Len;
+				const double a = N.x, b = N.y, c = N.z, d = -glm::dot(N, P0);
+				const Quadric Q = { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d };
+				for (uint32_t k = 0; k < 3; ++k) {
+					for (size_t e = 0; e < Q.size(); ++e) { Qs[Tri[k]][e] += Q[e]; }
+				}
+			}
+			for (uint32_t k = 0; k < 3; ++k) {
+				VertexTriangles[Tri[k]].push_back(static_cast<uint32_t>(t));
+				++EdgeUse[EdgeKey(Tri[k], Tri[(k + 1) % 3])];
+			}
+		}
+		std::vector<uint8_t> Locked(Vertices.size(), 0);
+		for (const auto& i : EdgeUse) {
+			if (1 == i.second) { Locked[i.first >> 32] = Locked[i.first & 0xffffffff] = 1; }
+		}
+
+		//!< Both directions of every edge, cheapest first
+		struct Collapse { double Cost; uint32_t From; uint32_t To; };
+		std::vector<Collapse> Collapses;
+		Collapses.reserve(EdgeUse.size() * 2);
+		for (const auto& i : EdgeUse) {
+			const auto a = static_cast<uint32_t>(i.first >> 32), b = static_cast<uint32_t>(i.first & 0xffffffff);
+			Quadric Q;
+			for (size_t e = 0; e < Q.size(); ++e) { Q[e] = Qs[a][e] + Qs[b][e]; }
+			if (!Locked[a]) { Collapses.push_back({ Evaluate(Q, Vertices[b].Position), a, b }); }
+			if (!Locked[b]) { Collapses.push_back({ Evaluate(Q, Vertices[a].Position), b, a }); }
+		}
+		std::sort(Collapses.begin(), Collapses.end(), [](const Collapse& lhs, const Collapse& rhs) {
+			return lhs.Cost != rhs.Cost ? lhs.Cost < rhs.Cost : (lhs.From != rhs.From ? lhs.From < rhs.From : lhs.To < rhs.To);
+		});
+
+		std::iota(Remap.begin(), Remap.end(), 0);
+		std::vector<uint8_t> Touched(Vertices.size(), 0);
+		const auto RemoveCount = TriangleCount - TargetIndexCount / 3;
+		size_t Removed = 0;
+		double MaxCost = 0.0;
+		for (const auto& c : Collapses) {
+			if (Removed >= RemoveCount) { break; }
+			if (Touched[c.From] || Touched[c.To]) { continue; }
+
+			//!< Triangles that survive the collapse must keep their orientation
+			auto IsFlipped = false;
+			size_t Shared = 0;
+			for (const auto t : VertexTriangles[c.From]) {
+				const auto* Tri = &Result[t * 3];
+				if (Tri[0] == c.To || Tri[1] == c.To || Tri[2] == c.To) { ++Shared; continue; }
+				std::array<glm::vec3, 3> Before, After;
+				for (uint32_t k = 0; k < 3; ++k) {
+					Before[k] = Vertices[Tri[k]].Position;
+					After[k] = Vertices[Tri[k] == c.From ? c.To : Tri[k]].Position;
+				}
+				const auto NB = glm::cross(Before[1] - Before[0], Before[2] - Before[0]);
+				const auto NA = glm::cross(After[1] - After[0], After[2] - After[0]);
+				if (glm::dot(NB, NA) <= 0.0f) { IsFlipped = true; break; }
+			}
+			if (IsFlipped || 0 == Shared) { continue; }
+
+			Remap[c.From] = c.To;
+			for (const auto t : VertexTriangles[c.From]) {
+				for (uint32_t k = 0; k < 3; ++k) { Touched[Result[t * 3 + k]] = 1; }
+			}
+			Removed += Shared;
+			MaxCost = (std::max)(MaxCost, c.Cost);
+		}
+		if (0 == Removed) { break; }
+		Error += static_cast<float>(std::sqrt((std::max)(MaxCost, 0.0)));
+
+		//!< Rebuild without the triangles that collapsed to a line
+		std::vector<uint32_t> Next;
+		Next.reserve(Result.size());
+		for (size_t t = 0; t < TriangleCount; ++t) {
+			const auto i0 = Remap[Result[t * 3]], i1 = Remap[Result[t * 3 + 1]], i2 = Remap[Result[t * 3 + 2]];
+			if (i0 != i1 && i1 != i2 && i2 != i0) { Next.insert(Next.end(), { i0, i1, i2 }); }
+		}
+		Result.swap(Next);
+	}
+	return Result;
+}
+
+//!< Appends up to MaxLevels - 1 simplified levels after level 0, each with Ratio of the triangles of the previous one
+//!< Stops early once a level cannot be reduced by at least 10 %
+inline void BuildLODs(Mesh& M, const uint32_t MaxLevels, const float Ratio)
+{
+	M.LODs.resize(1);
+	std::vector<uint32_t> Current(M.Indices.cbegin() + M.LODs[0].FirstIndex, M.Indices.cbegin() + M.LODs[0].FirstIndex + M.LODs[0].IndexCount);
+	while (M.LODs.size() < MaxLevels) {
+		const auto Target = static_cast<size_t>(Current.size() / 3 * Ratio) * 3;
+		float Error;
+		auto Next = Simplify(M.Vertices, Current, Target, Error);
+		if (Next.size() * 10 > Current.size() * 9 || Next.empty()) { break; }
+		M.LODs.push_back({ static_cast<uint32_t>(M.Indices.size()), static_cast<uint32_t>(Next.size()), M.LODs.back().Error + Error });
+		M.Indices.insert(M.Indices.end(), Next.cbegin(), Next.cend());
+		Current.swap(Next);
+	}
+}
+
+//!< Binary chain written by MeshTool : MAGIC, VERSION, counts, radius, vertices, indices, levels
+static const uint32_t MESH_MAGIC = 0x4d4b5650; //!< "PVKM"
+static const uint32_t MESH_VERSION = 1;
+inline bool WriteMesh(const std::string& Path, const Mesh& M)
+{
+	std::ofstream Out(Path.c_str(), std::ios::out | std::ios::binary);
+	if (Out.fail()) { return false; }
+	const std::array<uint32_t, 5> Header = { MESH_MAGIC, MESH_VERSION, static_cast<uint32_t>(M.Vertices.size()), static_cast<uint32_t>(M.Indices.size()), static_cast<uint32_t>(M.LODs.size()) };
+	Out.write(reinterpret_cast<const char*>(Header.data()), sizeof(Header));
+	Out.write(reinterpret_cast<const char*>(&M.Radius), sizeof(M.Radius));
+	Out.write(reinterpret_cast<const char*>(M.Vertices.data()), M.Vertices.size() * sizeof(M.Vertices[0]));
+	Out.write(reinterpret_cast<const char*>(M.Indices.data()), M.Indices.size() * sizeof(M.Indices[0]));
+	Out.write(reinterpret_cast<const char*>(M.LODs.data()), M.LODs.size() * sizeof(M.LODs[0]));
+	return !Out.fail();
+}
+inline bool LoadMesh(const std::string& Path, Mesh& M)
+{
+	std::ifstream In(Path.c_str(), std::ios::in | std::ios::binary);
+	if (In.fail()) { return false; }
+	std::array<uint32_t, 5> Header;
+	In.read(reinterpret_cast<char*>(Header.data()), sizeof(Header));
+	if (In.fail() || MESH_MAGIC != Header[0] || MESH_VERSION != Header[1] || 0 == Header[4]) { return false; }
+	In.read(reinterpret_cast<char*>(&M.Radius), sizeof(M.Radius));
+	M.Vertices.resize(Header[2]);
+	M.Indices.resize(Header[3]);
+	M.LODs.resize(Header[4]);
+	In.read(reinterpret_cast<char*>(M.Vertices.data()), M.Vertices.size() * sizeof(M.Vertices[0]));
+	In.read(reinterpret_cast<char*>(M.Indices.data()), M.Indices.size() * sizeof(M.Indices[0]));
+	In.read(reinterpret_cast<char*>(M.LODs.data()), M.LODs.size() * sizeof(M.LODs[0]));
+	if (In.fail()) { return false; }
+	for (const auto& i : M.LODs) {
+		if (static_cast<size_t>(i.FirstIndex) + i.IndexCount > M.Indices.size()) { return false; }
+	}
+	return std::all_of(M.Indices.cbegin(), M.Indices.cend(), [&](const uint32_t rhs) { return rhs < M.Vertices.size(); });
+}
+
+//!< Picks the level of every instance from its projected error once per frame and groups the instances into one batch per level
+//!< Instances keep their gl_InstanceIndex : a batch is a list of VkDrawIndexedIndirectCommand, one per run of consecutive instances at the same level
+//!< Runs start at a non zero firstInstance, drawing them indirectly needs drawIndirectFirstInstance (otherwise draw GetCommands() directly)
+class LODSelector
+{
+public:
+	struct Batch {
+		uint32_t FirstCommand = 0;
+		uint32_t CommandCount = 0;
+		uint32_t InstanceCount = 0;
+	};
+
+	//!< Threshold : allowed error on screen in pixels, Hysteresis : a coarser level is taken only below Threshold * (1 - Hysteresis), so instances near the boundary do not pop back and forth
+	LODSelector(const Mesh& M, const uint32_t InstanceCount, const float Threshold = 1.0f, const float Hysteresis = 0.25f)
+		: LODs(M.LODs), PixelThreshold(Threshold), CoarserThreshold(Threshold * (1.0f - Hysteresis)), Levels(InstanceCount, 0), Batches(M.LODs.size()), Runs(M.LODs.size()) {
+		Commands.reserve(InstanceCount);
+		for (auto& i : Runs) { i.reserve(InstanceCount); }
+	}
+
+	//!< PixelsPerUnit(Instance) : size of one mesh unit on screen in pixels
+	template<typename FN>
+	void Select(FN PixelsPerUnit) {
+		for (auto& i : Runs) { i.clear(); }
+		for (uint32_t i = 0; i < Levels.size(); ++i) {
+			const auto PPU = PixelsPerUnit(i);
+			auto L = Levels[i];
+			while (L > 0 && LODs[L].Error * PPU > PixelThreshold) { --L; }
+			while (L + 1u < LODs.size() && LODs[L + 1].Error * PPU <= CoarserThreshold) { ++L; }
+			Levels[i] = L;
+
+			auto& R = Runs[L];
+			if (!R.empty() && R.back().firstInstance + R.back().instanceCount == i) {
+				++R.back().instanceCount;
+			} else {
+				R.push_back({ LODs[L].IndexCount, 1, LODs[L].FirstIndex, 0, i });
+			}
+		}
+
+		Commands.clear();
+		Triangles = 0;
+		for (size_t i = 0; i < Runs.size(); ++i) {
+			auto& B = Batches[i];
+			B.FirstCommand = static_cast<uint32_t>(Commands.size());
+			B.CommandCount = static_cast<uint32_t>(Runs[i].size());
+			B.InstanceCount = 0;
+			for (const auto& j : Runs[i]) { B.InstanceCount += j.instanceCount; }
+			Commands.insert(Commands.end(), Runs[i].cbegin(), Runs[i].cend());
+			Triangles += static_cast<uint64_t>(LODs[i].IndexCount / 3) * B.InstanceCount;
+		}
+	}
+
+	//!< Grouped by level, Batches index into it
+	const std::vector<VkDrawIndexedIndirectCommand>& GetCommands() const { return Commands; }
+	const std::vector<Batch>& GetBatches() const { return Batches; }
+	uint64_t GetTriangleCount() const { return Triangles; }
+
+private:
+	std::vector<MeshLOD> LODs;
+	float PixelThreshold;
+	float CoarserThreshold;
+	std::vector<uint8_t> Levels;
+	std::vector<Batch> Batches;
+	std::vector<std::vector<VkDrawIndexedIndirectCommand>> Runs;
+	std::vector<VkDrawIndexedIndirectCommand> Commands;
+	uint64_t Triangles = 0;
+};
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <chrono>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "Common.h"
+#include "Mesh.h"
+
+//!< Positions and texture coordinates of a Wavefront OBJ, polygons are split into fans
+static bool LoadOBJ(const std::string& Path, Mesh& M)
+{
+	std::ifstream In(Path.c_str());
+	if (In.fail()) { return false; }
+	std::vector<glm::vec3> Positions;
+	std::vector<glm::vec2> Texcoords;
+	std::unordered_map<uint64_t, uint32_t> Indices;		//!< (position, texcoord) -> vertex
+	std::string Line;
+	while (std::getline(In, Line)) {
+		std::istringstream SS(Line);
+		std::string Tag;
+		SS >> Tag;
+		if ("v" == Tag) {
+			glm::vec3 P;
+			SS >> P.x >> P.y >> P.z;
+			Positions.push_back(P);
+		} else if ("vt" == Tag) {
+			glm::vec2 T;
+			SS >> T.x >> T.y;
+			Texcoords.push_back({ T.x, 1.0f - T.y });
+		} else if ("f" == Tag) {
+			std::vector<uint32_t> Face;
+			std::string Corner;
+			while (SS >> Corner) {
+				//!< v, v/vt, v/vt/vn, v//vn with 1 based or negative (relative) indices
+				const auto Resolve = [](const long Index, const size_t Count) { return static_cast<long>(Index < 0 ? static_cast<long>(Count) + Index : Index - 1); };
+				const auto Slash = Corner.find('/');
+				const auto PI = Resolve(std::atol(Corner.c_str()), Positions.size());
+				const auto TI = std::string::npos != Slash && Slash + 1 < Corner.size() && '/' != Corner[Slash + 1] ? Resolve(std::atol(Corner.c_str() + Slash + 1), Texcoords.size()) : -1;
+				if (PI < 0 || PI >= static_cast<long>(Positions.size()) || TI >= static_cast<long>(Texcoords.size())) { return false; }
+				const auto Key = (static_cast<uint64_t>(PI) << 32) | static_cast<uint32_t>(TI);
+				const auto It = Indices.find(Key);
+				if (Indices.end() != It) {
+					Face.push_back(It->second);
+				} else {
+					const auto Index = static_cast<uint32_t>(M.Vertices.size());
+					M.Vertices.push_back({ Positions[PI], { 1.0f, 1.0f, 1.0f, 1.0f }, TI >= 0 ? Texcoords[TI] : glm::vec2(0.0f) });
+					Indices.emplace(Key, Index);
+					Face.push_back(Index);
+				}
+			}
+			for (size_t i = 2; i < Face.size(); ++i) {
+				M.Indices.insert(M.Indices.end(), { Face[0], Face[i - 1], Face[i] });
+			}
+		}
+	}
+	for (const auto& i : M.Vertices) { M.Radius = (std::max)(M.Radius, glm::length(i.Position)); }
+	M.LODs.assign(1, { 0, static_cast<uint32_t>(M.Indices.size()), 0.0f });
+	return !M.Indices.empty();
+}
+
+//!< Builds the LOD chain offline and stores it next to the base mesh
+//!< MeshTool [<input.obj>] -o <output.mesh> [--levels <count>] [--ratio <ratio>], the Bench sphere is written when no input is given
+int main(int argc, char* argv[])
+{
+	std::string InputPath;
+	std::string OutputPath;
+	uint32_t Levels = 5;
+	float Ratio = 0.5f;
+	for (auto i = 1; i < argc; ++i) {
+		const std::string Arg = argv[i];
+		const auto HasValue = i + 1 < argc;
+		if ("-o" == Arg && HasValue) { OutputPath = argv[++i]; }
+		else if ("--levels" == Arg && HasValue) { Levels = (std::max)(1, std::atoi(argv[++i])); }
+		else if ("--ratio" == Arg && HasValue) { Ratio = static_cast<float>(std::atof(argv[++i])); }
+		else if ('-' != Arg[0] && InputPath.empty()) { InputPath = Arg; }
+		else { std::cerr << "Unknown option : " << Arg << std::endl; return 2; }
+	}
+	if (OutputPath.empty() || Ratio <= 0.0f || Ratio >= 1.0f) {
+		std::cerr << "Usage : MeshTool [<input.obj>] -o <output.mesh> [--levels <count>] [--ratio <0..1>]" << std::endl;
+		return 2;
+	}
+
+	Mesh M;
+	if (InputPath.empty()) {
+		M = CreateBumpySphere(48, 24, 0.08f);
+	} else if (!LoadOBJ(InputPath, M)) {
+		std::cerr << "Cannot read " << InputPath << std::endl;
+		return 2;
+	}
+
+	const auto Begin = std::chrono::steady_clock::now();
+	BuildLODs(M, Levels, Ratio);
+	const auto Elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Begin).count();
+
+	std::cout << "Vertices = " << M.Vertices.size() << ", Radius = " << M.Radius << ", Time = " << Elapsed << " msec" << std::endl;
+	for (size_t i = 0; i < M.LODs.size(); ++i) {
+		std::cout << "\tLOD" << i << " : Triangles = " << M.LODs[i].IndexCount / 3 << ", Error = " << M.LODs[i].Error << std::endl;
+	}
+	if (!WriteMesh(OutputPath, M)) {
+		std::cerr << "Cannot write " << OutputPath << std::endl;
+		return 1;
+	}
+	return 0;
+}
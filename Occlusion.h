@@ -0,0 +1,410 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstring>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "Common.h"
+#include "Handle.h"
+#include "Offscreen.h"
+
+//!< Screen bounds of one object as Cull.comp reads them
+struct OcclusionBounds
+{
+	glm::vec4 Rect;		//!< Normalized device (min x, min y, max x, max y)
+	glm::vec4 Depth;	//!< x : nearest depth of the object
+};
+
+//!< Occlusion culling against a hierarchical depth (Hi-Z) pyramid
+//!< Build() reduces the depth buffer of the frame into a max-depth mip chain (HiZ.comp), Cull() of the next frame tests every object's bounds against it (Cull.comp)
+//!< and writes 0 or 1 into the instanceCount of its draw command, so the draws never wait for this frame's depth
+//!< Objects hidden last frame that come into view show up one frame late
+class HiZCuller
+{
+public:
+	//!< The depth buffer has to be sampleable and the pyramid a storage image
+	static bool IsSupported(const VkPhysicalDevice PD, const VkFormat DepthFormat) {
+		VkFormatProperties FP;
+		vkGetPhysicalDeviceFormatProperties(PD, DepthFormat, &FP);
+		if (!(FP.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) { return false; }
+		vkGetPhysicalDeviceFormatProperties(PD, VK_FORMAT_R32_SFLOAT, &FP);
+		const VkFormatFeatureFlags Required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+		return (FP.optimalTilingFeatures & Required) == Required;
+	}
+
+	HiZCuller(const VkPhysicalDevice PD, const VkDevice Dev, const VkImageView DepthView, const uint32_t W, const uint32_t H, const VkShaderModule HiZShader, const VkShaderModule CullShader, const uint32_t MaxObjects)
+		: Device(Dev), DepthWidth(W), DepthHeight(H), Width((std::max)(W / 2, 1u)), Height((std::max)(H / 2, 1u)), MaxCount(MaxObjects) {
+		//!< Level 0 is half the depth buffer, down to 1 x 1
+		for (auto Size = (std::max)(Width, Height); Size; Size >>= 1) { ++LevelCount; }
+
+		//!< Pyramid
+		{
+			const VkImageCreateInfo ICI = {
+				VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+				nullptr,
+				0,
+				VK_IMAGE_TYPE_2D,
+				VK_FORMAT_R32_SFLOAT,
+				{ Width, Height, 1 },
+				LevelCount,
+				1,
+				VK_SAMPLE_COUNT_1_BIT,
+				VK_IMAGE_TILING_OPTIMAL,
+				VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+				VK_SHARING_MODE_EXCLUSIVE,
+				0, nullptr,
+				VK_IMAGE_LAYOUT_UNDEFINED
+			};
+			VERIFY_SUCCEEDED(vkCreateImage(Device, &ICI, GetAllocationCallbacks(), Pyramid.Put(Device)));
+
+			VkMemoryRequirements MR;
+			vkGetImageMemoryRequirements(Device, Pyramid, &MR);
+			const VkMemoryAllocateInfo MAI = {
+				VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+				nullptr,
+				MR.size,
+				GetMemoryTypeIndex(PD, MR, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+			};
+			VERIFY_SUCCEEDED(vkAllocateMemory(Device, &MAI, GetAllocationCallbacks(), PyramidMemory.Put(Device)));
+			VERIFY_SUCCEEDED(vkBindImageMemory(Device, Pyramid, PyramidMemory, 0));
+
+			//!< One view per level (written by HiZ.comp, read by the next level) and one of the whole chain (read by Cull.comp)
+			LevelViews.resize(LevelCount);
+			for (uint32_t i = 0; i <= LevelCount; ++i) {
+				const auto IsAll = LevelCount == i;
+				const VkImageViewCreateInfo IVCI = {
+					VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+					nullptr,
+					0,
+					Pyramid,
+					VK_IMAGE_VIEW_TYPE_2D,
+					VK_FORMAT_R32_SFLOAT,
+					{ VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, },
+					{ VK_IMAGE_ASPECT_COLOR_BIT, IsAll ? 0 : i, IsAll ? LevelCount : 1, 0, 1 }
+				};
+				VERIFY_SUCCEEDED(vkCreateImageView(Device, &IVCI, GetAllocationCallbacks(), (IsAll ? PyramidView : LevelViews[i]).Put(Device)));
+			}
+		}
+
+		//!< Texel fetches only, but combined image samplers need one
+		const VkSamplerCreateInfo SCI = {
+			VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+			nullptr,
+			0,
+			VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_MIPMAP_MODE_NEAREST,
+			VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			0.0f,
+			VK_FALSE, 1.0f,
+			VK_FALSE, VK_COMPARE_OP_NEVER,
+			0.0f, static_cast<float>(LevelCount),
+			VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+			VK_FALSE
+		};
+		VERIFY_SUCCEEDED(vkCreateSampler(Device, &SCI, GetAllocationCallbacks(), Sampler.Put(Device)));
+
+		//!< Bounds and draw commands are host visible so that the draw list can be seeded from the CPU, the visible count is read back
+		CreateHostVisibleBuffer(BoundsBuffer, BoundsMemory, &BoundsData, PD, Device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MaxCount * sizeof(OcclusionBounds));
+		CreateHostVisibleBuffer(CommandBuffer, CommandMemory, &CommandData, PD, Device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, MaxCount * sizeof(VkDrawIndexedIndirectCommand));
+		CreateHostVisibleBuffer(StatsBuffer, StatsMemory, &StatsData, PD, Device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(uint32_t));
+
+		//!< Descriptor set layouts
+		{
+			const std::array<VkDescriptorSetLayoutBinding, 2> DSLBs = { {
+				{ 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+				{ 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+			} };
+			const VkDescriptorSetLayoutCreateInfo DSLCI = {
+				VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+				nullptr,
+				0,
+				static_cast<uint32_t>(DSLBs.size()), DSLBs.data()
+			};
+			VERIFY_SUCCEEDED(vkCreateDescriptorSetLayout(Device, &DSLCI, GetAllocationCallbacks(), HiZDescriptorSetLayout.Put(Device)));
+		}
+		{
+			const std::array<VkDescriptorSetLayoutBinding, 4> DSLBs = { {
+				{ 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+				{ 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+				{ 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+				{ 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+			} };
+			const VkDescriptorSetLayoutCreateInfo DSLCI = {
+				VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+				nullptr,
+				0,
+				static_cast<uint32_t>(DSLBs.size()), DSLBs.data()
+			};
+			VERIFY_SUCCEEDED(vkCreateDescriptorSetLayout(Device, &DSLCI, GetAllocationCallbacks(), CullDescriptorSetLayout.Put(Device)));
+		}
+
+		//!< Descriptor sets, one per level + cull
+		{
+			const std::array<VkDescriptorPoolSize, 3> DPSs = { {
+				{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, LevelCount + 1 },
+				{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, LevelCount },
+				{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 },
+			} };
+			const VkDescriptorPoolCreateInfo DPCI = {
+				VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+				nullptr,
+				0,
+				LevelCount + 1,
+				static_cast<uint32_t>(DPSs.size()), DPSs.data()
+			};
+			VERIFY_SUCCEEDED(vkCreateDescriptorPool(Device, &DPCI, GetAllocationCallbacks(), DescriptorPool.Put(Device)));
+
+			HiZDescriptorSets.resize(LevelCount);
+			const std::vector<VkDescriptorSetLayout> DSLs(LevelCount, HiZDescriptorSetLayout);
+			const VkDescriptorSetAllocateInfo DSAI = {
+				VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				nullptr,
+				DescriptorPool,
+				static_cast<uint32_t>(DSLs.size()), DSLs.data()
+			};
+			VERIFY_SUCCEEDED(vkAllocateDescriptorSets(Device, &DSAI, HiZDescriptorSets.data()));
+			const VkDescriptorSetLayout CullDSL = CullDescriptorSetLayout;
+			const VkDescriptorSetAllocateInfo CullDSAI = {
+				VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				nullptr,
+				DescriptorPool,
+				1, &CullDSL
+			};
+			VERIFY_SUCCEEDED(vkAllocateDescriptorSets(Device, &CullDSAI, &CullDescriptorSet));
+
+			for (uint32_t i = 0; i < LevelCount; ++i) {
+				const std::array<VkDescriptorImageInfo, 2> DIIs = { {
+					0 == i ? VkDescriptorImageInfo({ Sampler, DepthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL }) : VkDescriptorImageInfo({ Sampler, LevelViews[i - 1], VK_IMAGE_LAYOUT_GENERAL }),
+					{ VK_NULL_HANDLE, LevelViews[i], VK_IMAGE_LAYOUT_GENERAL },
+				} };
+				const std::array<VkWriteDescriptorSet, 2> WDSs = { {
+					{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, HiZDescriptorSets[i], 0, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &DIIs[0], nullptr, nullptr },
+					{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, HiZDescriptorSets[i], 1, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &DIIs[1], nullptr, nullptr },
+				} };
+				vkUpdateDescriptorSets(Device, static_cast<uint32_t>(WDSs.size()), WDSs.data(), 0, nullptr);
+			}
+			{
+				const VkDescriptorImageInfo DII = { Sampler, PyramidView, VK_IMAGE_LAYOUT_GENERAL };
+				const std::array<VkDescriptorBufferInfo, 3> DBIs = { {
+					{ BoundsBuffer, 0, VK_WHOLE_SIZE },
+					{ CommandBuffer, 0, VK_WHOLE_SIZE },
+					{ StatsBuffer, 0, VK_WHOLE_SIZE },
+				} };
+				const std::array<VkWriteDescriptorSet, 2> WDSs = { {
+					{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, CullDescriptorSet, 0, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &DII, nullptr, nullptr },
+					{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, CullDescriptorSet, 1, 0, static_cast<uint32_t>(DBIs.size()), VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, DBIs.data(), nullptr },
+				} };
+				vkUpdateDescriptorSets(Device, static_cast<uint32_t>(WDSs.size()), WDSs.data(), 0, nullptr);
+			}
+		}
+
+		//!< Pipelines
+		CreatePipeline(HiZPipelineLayout, HiZPipeline, HiZDescriptorSetLayout, sizeof(int32_t) * 4, HiZShader);
+		CreatePipeline(CullPipelineLayout, CullPipeline, CullDescriptorSetLayout, sizeof(uint32_t) * 2, CullShader);
+	}
+
+	//!< Bounds and draw commands of up to MaxObjects objects (one command per object), forgets the pyramid so that everything is drawn until it has been rebuilt
+	void SetObjects(const std::vector<OcclusionBounds>& Bounds, const std::vector<VkDrawIndexedIndirectCommand>& Commands) {
+		Count = static_cast<uint32_t>((std::min)({ Bounds.size(), Commands.size(), static_cast<size_t>(MaxCount) }));
+		memcpy(BoundsData, Bounds.data(), Count * sizeof(Bounds[0]));
+		memcpy(CommandData, Commands.data(), Count * sizeof(Commands[0]));
+		HasHistory = IsCulled = false;
+	}
+
+	//!< Before the render pass, the draws read the commands at DRAW_INDIRECT
+	void Cull(const VkCommandBuffer CB) {
+		IsCulled = HasHistory;
+		if (!IsCulled) { return; }
+
+		vkCmdFillBuffer(CB, StatsBuffer, 0, sizeof(uint32_t), 0);
+		const std::array<VkBufferMemoryBarrier, 2> Before = { {
+			{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER, nullptr, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, StatsBuffer, 0, VK_WHOLE_SIZE },
+			{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER, nullptr, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, CommandBuffer, 0, VK_WHOLE_SIZE },
+		} };
+		vkCmdPipelineBarrier(CB, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, static_cast<uint32_t>(Before.size()), Before.data(), 0, nullptr);
+
+		vkCmdBindPipeline(CB, VK_PIPELINE_BIND_POINT_COMPUTE, CullPipeline);
+		vkCmdBindDescriptorSets(CB, VK_PIPELINE_BIND_POINT_COMPUTE, CullPipelineLayout, 0, 1, &CullDescriptorSet, 0, nullptr);
+		const std::array<uint32_t, 2> PC = { Count, LevelCount };
+		vkCmdPushConstants(CB, CullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PC), PC.data());
+		vkCmdDispatch(CB, (Count + 63) / 64, 1, 1);
+
+		const VkBufferMemoryBarrier ToIndirect = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER, nullptr, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, CommandBuffer, 0, VK_WHOLE_SIZE };
+		vkCmdPipelineBarrier(CB, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr, 1, &ToIndirect, 0, nullptr);
+		const VkBufferMemoryBarrier ToHost = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER, nullptr, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, StatsBuffer, 0, VK_WHOLE_SIZE };
+		vkCmdPipelineBarrier(CB, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &ToHost, 0, nullptr);
+	}
+
+	//!< After the render pass (its dependency makes the depth writes visible to compute)
+	void Build(const VkCommandBuffer CB) {
+		//!< The pyramid stays in GENERAL, written as storage image and fetched as sampled image
+		const VkImageMemoryBarrier ToGeneral = {
+			VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			nullptr,
+			HasHistory ? static_cast<VkAccessFlags>(VK_ACCESS_SHADER_READ_BIT) : 0, VK_ACCESS_SHADER_WRITE_BIT,
+			HasHistory ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+			Pyramid,
+			{ VK_IMAGE_ASPECT_COLOR_BIT, 0, LevelCount, 0, 1 }
+		};
+		vkCmdPipelineBarrier(CB, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &ToGeneral);
+
+		vkCmdBindPipeline(CB, VK_PIPELINE_BIND_POINT_COMPUTE, HiZPipeline);
+		auto SrcW = DepthWidth, SrcH = DepthHeight;
+		for (uint32_t i = 0; i < LevelCount; ++i) {
+			const auto DstW = (std::max)(Width >> i, 1u), DstH = (std::max)(Height >> i, 1u);
+			vkCmdBindDescriptorSets(CB, VK_PIPELINE_BIND_POINT_COMPUTE, HiZPipelineLayout, 0, 1, &HiZDescriptorSets[i], 0, nullptr);
+			const std::array<int32_t, 4> PC = { static_cast<int32_t>(SrcW), static_cast<int32_t>(SrcH), static_cast<int32_t>(DstW), static_cast<int32_t>(DstH) };
+			vkCmdPushConstants(CB, HiZPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PC), PC.data());
+			vkCmdDispatch(CB, (DstW + 7) / 8, (DstH + 7) / 8, 1);
+
+			//!< Read by the next level, and by Cull() of the next frame
+			const VkImageMemoryBarrier IMB = {
+				VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				nullptr,
+				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+				Pyramid,
+				{ VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 }
+			};
+			vkCmdPipelineBarrier(CB, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &IMB);
+			SrcW = DstW;
+			SrcH = DstH;
+		}
+		HasHistory = true;
+	}
+
+	VkBuffer GetCommandBuffer() const { return CommandBuffer; }
+	//!< Host view of the commands, written by the last completed Cull()
+	const VkDrawIndexedIndirectCommand* GetCommands() const { return reinterpret_cast<const VkDrawIndexedIndirectCommand*>(CommandData); }
+	uint32_t GetCount() const { return Count; }
+	uint32_t GetLevelCount() const { return LevelCount; }
+	//!< Objects drawn by the last frame, valid once it has completed
+	uint32_t GetVisibleCount() const { return IsCulled ? *reinterpret_cast<const uint32_t*>(StatsData) : Count; }
+
+private:
+	void CreatePipeline(PipelineLayoutObject& PL, PipelineObject& Pipeline, const VkDescriptorSetLayout DSL, const uint32_t PushConstantSize, const VkShaderModule SM) {
+		const VkPushConstantRange PCR = { VK_SHADER_STAGE_COMPUTE_BIT, 0, PushConstantSize };
+		const VkPipelineLayoutCreateInfo PLCI = {
+			VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			nullptr,
+			0,
+			1, &DSL,
+			1, &PCR
+		};
+		VERIFY_SUCCEEDED(vkCreatePipelineLayout(Device, &PLCI, GetAllocationCallbacks(), PL.Put(Device)));
+		const VkComputePipelineCreateInfo CPCI = {
+			VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+			nullptr,
+			0,
+			{ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_COMPUTE_BIT, SM, "main", nullptr },
+			PL,
+			VK_NULL_HANDLE, -1
+		};
+		VERIFY_SUCCEEDED(vkCreateComputePipelines(Device, VK_NULL_HANDLE, 1, &CPCI, GetAllocationCallbacks(), Pipeline.Put(Device)));
+	}
+
+	VkDevice Device;
+	uint32_t DepthWidth;
+	uint32_t DepthHeight;
+	uint32_t Width;			//!< Level 0
+	uint32_t Height;
+	uint32_t LevelCount = 0;
+	uint32_t MaxCount;
+	uint32_t Count = 0;
+	bool HasHistory = false;	//!< The pyramid holds the depth of a frame drawn with the current objects
+	bool IsCulled = false;		//!< The last frame ran Cull.comp
+
+	ImageObject Pyramid;
+	DeviceMemoryObject PyramidMemory;
+	std::vector<ImageViewObject> LevelViews;
+	ImageViewObject PyramidView;
+	SamplerObject Sampler;
+
+	BufferObject BoundsBuffer;
+	DeviceMemoryObject BoundsMemory;
+	void* BoundsData = nullptr;
+	BufferObject CommandBuffer;
+	DeviceMemoryObject CommandMemory;
+	void* CommandData = nullptr;
+	BufferObject StatsBuffer;
+	DeviceMemoryObject StatsMemory;
+	void* StatsData = nullptr;
+
+	DescriptorSetLayoutObject HiZDescriptorSetLayout;
+	DescriptorSetLayoutObject CullDescriptorSetLayout;
+	DescriptorPoolObject DescriptorPool;
+	std::vector<VkDescriptorSet> HiZDescriptorSets;
+	VkDescriptorSet CullDescriptorSet = VK_NULL_HANDLE;
+	PipelineLayoutObject HiZPipelineLayout;
+	PipelineLayoutObject CullPipelineLayout;
+	PipelineObject HiZPipeline;
+	PipelineObject CullPipeline;
+};
+
+//!< Fallback when the pyramid cannot be built : every object's proxy is drawn under an occlusion query against the occluder depth,
+//!< the results are read once the frame has completed and written into the instanceCount of its draw command for the next frame
+class QueryCuller
+{
+public:
+	QueryCuller(const VkPhysicalDevice PD, const VkDevice Dev, const uint32_t MaxObjects) : Device(Dev), MaxCount(MaxObjects), Results(MaxObjects) {
+		const VkQueryPoolCreateInfo QPCI = {
+			VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			nullptr,
+			0,
+			VK_QUERY_TYPE_OCCLUSION,
+			MaxCount,
+			0
+		};
+		VERIFY_SUCCEEDED(vkCreateQueryPool(Device, &QPCI, GetAllocationCallbacks(), QueryPool.Put(Device)));
+		CreateHostVisibleBuffer(CommandBuffer, CommandMemory, &CommandData, PD, Device, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, MaxCount * sizeof(VkDrawIndexedIndirectCommand));
+	}
+
+	void SetObjects(const std::vector<VkDrawIndexedIndirectCommand>& Commands) {
+		Count = static_cast<uint32_t>((std::min)(Commands.size(), static_cast<size_t>(MaxCount)));
+		memcpy(CommandData, Commands.data(), Count * sizeof(Commands[0]));
+		VisibleCount = Count;
+	}
+
+	//!< Outside of the render pass
+	void Reset(const VkCommandBuffer CB) const { vkCmdResetQueryPool(CB, QueryPool, 0, Count); }
+	//!< Inside of the render pass after the occluders, Fn(i) draws the proxy of object i without writing color or depth
+	template<typename FN>
+	void Query(const VkCommandBuffer CB, FN Fn) const {
+		for (uint32_t i = 0; i < Count; ++i) {
+			vkCmdBeginQuery(CB, QueryPool, i, 0);
+			Fn(i);
+			vkCmdEndQuery(CB, QueryPool, i);
+		}
+	}
+	//!< Once the frame has completed, nothing is waited for
+	void Feedback() {
+		if (!Count || VK_SUCCESS != vkGetQueryPoolResults(Device, QueryPool, 0, Count, Count * sizeof(Results[0]), Results.data(), sizeof(Results[0]), VK_QUERY_RESULT_64_BIT)) { return; }
+		const auto Commands = reinterpret_cast<VkDrawIndexedIndirectCommand*>(CommandData);
+		VisibleCount = 0;
+		for (uint32_t i = 0; i < Count; ++i) {
+			Commands[i].instanceCount = Results[i] ? 1 : 0;
+			VisibleCount += Commands[i].instanceCount;
+		}
+	}
+
+	VkBuffer GetCommandBuffer() const { return CommandBuffer; }
+	const VkDrawIndexedIndirectCommand* GetCommands() const { return reinterpret_cast<const VkDrawIndexedIndirectCommand*>(CommandData); }
+	uint32_t GetCount() const { return Count; }
+	//!< Objects the current draw commands draw
+	uint32_t GetVisibleCount() const { return VisibleCount; }
+
+private:
+	VkDevice Device;
+	uint32_t MaxCount;
+	uint32_t Count = 0;
+	uint32_t VisibleCount = 0;
+	std::vector<uint64_t> Results;
+	QueryPoolObject QueryPool;
+	BufferObject CommandBuffer;
+	DeviceMemoryObject CommandMemory;
+	void* CommandData = nullptr;
+};
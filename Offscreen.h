@@ -0,0 +1,252 @@
+#pragma once
+
+#include <vector>
+#include <array>
+
+#include "Common.h"
+#include "Handle.h"
+
+static void CreateHostVisibleBuffer(BufferObject& Buffer, DeviceMemoryObject& Memory, void** Data, const VkPhysicalDevice PD, const VkDevice Device, const VkBufferUsageFlags BUF, const VkDeviceSize Size)
+{
+	const VkBufferCreateInfo BCI = {
+		VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		nullptr,
+		0,
+		Size,
+		BUF,
+		VK_SHARING_MODE_EXCLUSIVE,
+		0, nullptr
+	};
+	VERIFY_SUCCEEDED(vkCreateBuffer(Device, &BCI, GetAllocationCallbacks(), Buffer.Put(Device)));
+
+	VkMemoryRequirements MR;
+	vkGetBufferMemoryRequirements(Device, Buffer, &MR);
+	const VkMemoryAllocateInfo MAI = {
+		VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		nullptr,
+		MR.size,
+		GetMemoryTypeIndex(PD, MR, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+	};
+	VERIFY_SUCCEEDED(vkAllocateMemory(Device, &MAI, GetAllocationCallbacks(), Memory.Put(Device)));
+	VERIFY_SUCCEEDED(vkBindBufferMemory(Device, Buffer, Memory, 0));
+	VERIFY_SUCCEEDED(vkMapMemory(Device, Memory, 0, VK_WHOLE_SIZE, static_cast<VkMemoryMapFlags>(0), Data));
+}
+
+//!< RGBA8 color target without a swapchain (Bench, Replay), optionally with a depth attachment
+//!< The render pass leaves the image in TRANSFER_SRC, ReadBack() copies it into a host visible buffer
+//!< Depth is cleared every pass and left in DEPTH_STENCIL_READ_ONLY, sampleable by compute shaders afterwards (hierarchical depth)
+class OffscreenTarget
+{
+public:
+	OffscreenTarget(const VkPhysicalDevice PD, const VkDevice Dev, const uint32_t W, const uint32_t H, const VkFormat DepthFmt = VK_FORMAT_UNDEFINED) : Width(W), Height(H), DepthFormat(DepthFmt) {
+		const VkImageCreateInfo ICI = {
+			VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			nullptr,
+			0,
+			VK_IMAGE_TYPE_2D,
+			VK_FORMAT_R8G8B8A8_UNORM,
+			{ Width, Height, 1 },
+			1,
+			1,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			VK_SHARING_MODE_EXCLUSIVE,
+			0, nullptr,
+			VK_IMAGE_LAYOUT_UNDEFINED
+		};
+		VERIFY_SUCCEEDED(vkCreateImage(Dev, &ICI, GetAllocationCallbacks(), Image.Put(Dev)));
+
+		VkMemoryRequirements MR;
+		vkGetImageMemoryRequirements(Dev, Image, &MR);
+		const VkMemoryAllocateInfo MAI = {
+			VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			nullptr,
+			MR.size,
+			GetMemoryTypeIndex(PD, MR, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+		};
+		VERIFY_SUCCEEDED(vkAllocateMemory(Dev, &MAI, GetAllocationCallbacks(), Memory.Put(Dev)));
+		VERIFY_SUCCEEDED(vkBindImageMemory(Dev, Image, Memory, 0));
+
+		const VkImageViewCreateInfo IVCI = {
+			VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			nullptr,
+			0,
+			Image,
+			VK_IMAGE_VIEW_TYPE_2D,
+			VK_FORMAT_R8G8B8A8_UNORM,
+			{ VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, },
+			{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+		};
+		VERIFY_SUCCEEDED(vkCreateImageView(Dev, &IVCI, GetAllocationCallbacks(), View.Put(Dev)));
+
+		if (HasDepth()) {
+			const VkImageCreateInfo DICI = {
+				VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+				nullptr,
+				0,
+				VK_IMAGE_TYPE_2D,
+				DepthFormat,
+				{ Width, Height, 1 },
+				1,
+				1,
+				VK_SAMPLE_COUNT_1_BIT,
+				VK_IMAGE_TILING_OPTIMAL,
+				VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+				VK_SHARING_MODE_EXCLUSIVE,
+				0, nullptr,
+				VK_IMAGE_LAYOUT_UNDEFINED
+			};
+			VERIFY_SUCCEEDED(vkCreateImage(Dev, &DICI, GetAllocationCallbacks(), DepthImage.Put(Dev)));
+
+			VkMemoryRequirements DMR;
+			vkGetImageMemoryRequirements(Dev, DepthImage, &DMR);
+			const VkMemoryAllocateInfo DMAI = {
+				VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+				nullptr,
+				DMR.size,
+				GetMemoryTypeIndex(PD, DMR, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+			};
+			VERIFY_SUCCEEDED(vkAllocateMemory(Dev, &DMAI, GetAllocationCallbacks(), DepthMemory.Put(Dev)));
+			VERIFY_SUCCEEDED(vkBindImageMemory(Dev, DepthImage, DepthMemory, 0));
+
+			const VkImageViewCreateInfo DIVCI = {
+				VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+				nullptr,
+				0,
+				DepthImage,
+				VK_IMAGE_VIEW_TYPE_2D,
+				DepthFormat,
+				{ VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, },
+				{ VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 }
+			};
+			VERIFY_SUCCEEDED(vkCreateImageView(Dev, &DIVCI, GetAllocationCallbacks(), DepthView.Put(Dev)));
+		}
+
+		//!< Render pass
+		{
+			const std::array<VkAttachmentDescription, 2> ADs = { {
+				{
+					0,
+					VK_FORMAT_R8G8B8A8_UNORM,
+					VK_SAMPLE_COUNT_1_BIT,
+					VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE,
+					VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE,
+					VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+				},
+				{
+					0,
+					DepthFormat,
+					VK_SAMPLE_COUNT_1_BIT,
+					VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE,
+					VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE,
+					VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+				},
+			} };
+			const std::array<VkAttachmentReference, 1> ColorARs = { { { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL }, } };
+			const VkAttachmentReference DepthAR = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+			const std::array<VkSubpassDescription, 1> SDs = { {
+				{
+					0,
+					VK_PIPELINE_BIND_POINT_GRAPHICS,
+					0, nullptr,
+					static_cast<uint32_t>(ColorARs.size()), ColorARs.data(), nullptr,
+					HasDepth() ? &DepthAR : nullptr,
+					0, nullptr
+				},
+			} };
+			//!< Depth of the previous pass may still be read by compute, and this pass' depth is read by compute after it
+			//!< Being explicit, these replace the implicit external dependencies, so they also order the color attachment (its final layout change against ReadBack())
+			const std::array<VkSubpassDependency, 2> SDeps = { {
+				{
+					VK_SUBPASS_EXTERNAL, 0,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+					VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+					0
+				},
+				{
+					0, VK_SUBPASS_EXTERNAL,
+					VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+					0
+				},
+			} };
+			const VkRenderPassCreateInfo RPCI = {
+				VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+				nullptr,
+				0,
+				HasDepth() ? 2u : 1u, ADs.data(),
+				static_cast<uint32_t>(SDs.size()), SDs.data(),
+				HasDepth() ? static_cast<uint32_t>(SDeps.size()) : 0u, SDeps.data()
+			};
+			VERIFY_SUCCEEDED(vkCreateRenderPass(Dev, &RPCI, GetAllocationCallbacks(), RenderPass.Put(Dev)));
+		}
+
+		//!< Framebuffer
+		{
+			const std::array<VkImageView, 2> IVs = { View, DepthView };
+			const VkFramebufferCreateInfo FCI = {
+				VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+				nullptr,
+				0,
+				RenderPass,
+				HasDepth() ? 2u : 1u, IVs.data(),
+				Width, Height,
+				1
+			};
+			VERIFY_SUCCEEDED(vkCreateFramebuffer(Dev, &FCI, GetAllocationCallbacks(), Framebuffer.Put(Dev)));
+		}
+
+		CreateHostVisibleBuffer(ReadBackBuffer, ReadBackMemory, &ReadBackData, PD, Dev, VK_BUFFER_USAGE_TRANSFER_DST_BIT, static_cast<VkDeviceSize>(Width) * Height * 4);
+	}
+
+	uint32_t GetWidth() const { return Width; }
+	uint32_t GetHeight() const { return Height; }
+	bool HasDepth() const { return VK_FORMAT_UNDEFINED != DepthFormat; }
+	VkFormat GetDepthFormat() const { return DepthFormat; }
+	VkImageView GetDepthView() const { return DepthView; }
+	VkRenderPass GetRenderPass() const { return RenderPass; }
+	VkFramebuffer GetFramebuffer() const { return Framebuffer; }
+	//!< Tightly packed RGBA8 rows, valid once the command buffer of ReadBack() has completed
+	const uint8_t* GetPixels() const { return reinterpret_cast<const uint8_t*>(ReadBackData); }
+
+	//!< Record after the render pass
+	void ReadBack(const VkCommandBuffer CB) const {
+		const VkImageMemoryBarrier IMB = {
+			VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			nullptr,
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+			Image,
+			{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+		};
+		vkCmdPipelineBarrier(CB, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &IMB);
+		const VkBufferImageCopy BIC = { 0, 0, 0, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 }, { 0, 0, 0 }, { Width, Height, 1 } };
+		vkCmdCopyImageToBuffer(CB, Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, ReadBackBuffer, 1, &BIC);
+		const VkBufferMemoryBarrier BMB = {
+			VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			nullptr,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+			ReadBackBuffer, 0, VK_WHOLE_SIZE
+		};
+		vkCmdPipelineBarrier(CB, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &BMB, 0, nullptr);
+	}
+
+private:
+	uint32_t Width;
+	uint32_t Height;
+	VkFormat DepthFormat;
+	ImageObject Image;
+	DeviceMemoryObject Memory;
+	ImageViewObject View;
+	ImageObject DepthImage;
+	DeviceMemoryObject DepthMemory;
+	ImageViewObject DepthView;
+	RenderPassObject RenderPass;
+	FramebufferObject Framebuffer;
+	BufferObject ReadBackBuffer;
+	DeviceMemoryObject ReadBackMemory;
+	void* ReadBackData = nullptr;
+};
@@ -0,0 +1,362 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <chrono>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+#include "Common.h"
+#include "Handle.h"
+#include "ThreadPool.h"
+
+//!< FNV-1a
+class Hasher
+{
+public:
+	Hasher& Add(const void* Data, const size_t Size) {
+		const auto Bytes = reinterpret_cast<const uint8_t*>(Data);
+		for (size_t i = 0; i < Size; ++i) {
+			Value = (Value ^ Bytes[i]) * 0x100000001b3ull;
+		}
+		return *this;
+	}
+	//!< Only for types without padding
+	template<typename T> Hasher& Add(const T& rhs) { return Add(&rhs, sizeof(rhs)); }
+	Hasher& Add(const char* Str) { return Add(Str, strlen(Str)); }
+	uint64_t Get() const { return Value; }
+
+private:
+	uint64_t Value = 0xcbf29ce484222325ull;
+};
+
+using Vertex_PositionColorTexcoord = struct Vertex_PositionColorTexcoord { glm::vec3 Position; glm::vec4 Color; glm::vec2 Texcoord; };
+
+//!< Everything that differs between material / state permutations
+struct PipelineState
+{
+	float Scale = 1.0f;					//!< VS.vert constant_id = 0
+	int32_t ColorMode = 0;				//!< FS.frag constant_id = 1
+	VkPrimitiveTopology Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+	VkCullModeFlags CullMode = VK_CULL_MODE_BACK_BIT;
+	VkBool32 BlendEnable = VK_FALSE;
+	int32_t InstanceGrid = 1;			//!< VS.vert constant_id = 2
+	float Depth = 0.0f;					//!< VS.vert constant_id = 3
+	int32_t Layers = 1;					//!< VS.vert constant_id = 4
+	VkBool32 DepthTestEnable = VK_FALSE;
+	VkBool32 DepthWriteEnable = VK_FALSE;
+	VkBool32 ColorWriteEnable = VK_TRUE;	//!< VK_FALSE for depth only passes
+};
+
+//!< Distance VS.vert divides the instance by (1 without Depth), keep in sync with the shader
+inline float GetInstanceDistance(const PipelineState& PS, const uint32_t Instance)
+{
+	if (PS.Depth <= 0.0f) { return 1.0f; }
+	const auto Grid = (std::max)(PS.InstanceGrid, 1);
+	if (PS.Layers > 1) {
+		const auto Layer = static_cast<float>(static_cast<int32_t>(Instance) / (Grid * Grid));
+		return 1.0f + PS.Depth * (static_cast<float>(PS.Layers - 1) - Layer) / static_cast<float>(PS.Layers - 1);
+	}
+	const auto Row = static_cast<float>((static_cast<int32_t>(Instance) / Grid) % Grid);
+	return 1.0f + PS.Depth * Row / (std::max)(static_cast<float>(Grid) - 1.0f, 1.0f);
+}
+//!< Normalized device rectangle (min x, min y, max x, max y) of an instance whose vertices lie within Radius of the origin, keep in sync with VS.vert
+inline glm::vec4 GetInstanceRect(const PipelineState& PS, const uint32_t Instance, const float Radius)
+{
+	const auto Grid = (std::max)(PS.InstanceGrid, 1);
+	const auto Cell = glm::vec2(static_cast<float>(static_cast<int32_t>(Instance) % Grid), static_cast<float>((static_cast<int32_t>(Instance) / Grid) % Grid));
+	const auto Offset = (Cell + 0.5f) / static_cast<float>(Grid) * 2.0f - 1.0f;
+	const auto Extent = Radius * PS.Scale / static_cast<float>(Grid);
+	const auto W = GetInstanceDistance(PS, Instance);
+	return glm::vec4(Offset - Extent, Offset + Extent) / W;
+}
+//!< Depth every vertex of the instance ends up at, 0 (nearest) without Depth since the mesh z is passed through
+inline float GetInstanceDepth(const PipelineState& PS, const uint32_t Instance)
+{
+	return PS.Depth > 0.0f ? (GetInstanceDistance(PS, Instance) - 1.0f) / PS.Depth : 0.0f;
+}
+
+//!< Hash of the create info contents (not pointers), derivative flags and base pipeline are excluded
+static uint64_t HashCreateInfo(const VkGraphicsPipelineCreateInfo& GPCI)
+{
+	Hasher H;
+	H.Add(GPCI.flags & ~(VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT | VK_PIPELINE_CREATE_DERIVATIVE_BIT));
+	for (uint32_t i = 0; i < GPCI.stageCount; ++i) {
+		const auto& PSSCI = GPCI.pStages[i];
+		H.Add(PSSCI.stage).Add(PSSCI.module).Add(PSSCI.pName);
+		if (nullptr != PSSCI.pSpecializationInfo) {
+			const auto& SI = *PSSCI.pSpecializationInfo;
+			for (uint32_t j = 0; j < SI.mapEntryCount; ++j) { H.Add(SI.pMapEntries[j]); }
+			H.Add(SI.pData, SI.dataSize);
+		}
+	}
+	if (nullptr != GPCI.pVertexInputState) {
+		const auto& PVISCI = *GPCI.pVertexInputState;
+		for (uint32_t i = 0; i < PVISCI.vertexBindingDescriptionCount; ++i) { H.Add(PVISCI.pVertexBindingDescriptions[i]); }
+		for (uint32_t i = 0; i < PVISCI.vertexAttributeDescriptionCount; ++i) { H.Add(PVISCI.pVertexAttributeDescriptions[i]); }
+	}
+	if (nullptr != GPCI.pInputAssemblyState) {
+		H.Add(GPCI.pInputAssemblyState->topology).Add(GPCI.pInputAssemblyState->primitiveRestartEnable);
+	}
+	if (nullptr != GPCI.pRasterizationState) {
+		const auto& PRSCI = *GPCI.pRasterizationState;
+		H.Add(PRSCI.depthClampEnable).Add(PRSCI.rasterizerDiscardEnable).Add(PRSCI.polygonMode).Add(PRSCI.cullMode).Add(PRSCI.frontFace);
+		H.Add(PRSCI.depthBiasEnable).Add(PRSCI.depthBiasConstantFactor).Add(PRSCI.depthBiasClamp).Add(PRSCI.depthBiasSlopeFactor).Add(PRSCI.lineWidth);
+	}
+	if (nullptr != GPCI.pMultisampleState) {
+		H.Add(GPCI.pMultisampleState->rasterizationSamples).Add(GPCI.pMultisampleState->sampleShadingEnable);
+	}
+	if (nullptr != GPCI.pDepthStencilState) {
+		const auto& PDSSCI = *GPCI.pDepthStencilState;
+		H.Add(PDSSCI.depthTestEnable).Add(PDSSCI.depthWriteEnable).Add(PDSSCI.depthCompareOp).Add(PDSSCI.stencilTestEnable).Add(PDSSCI.front).Add(PDSSCI.back);
+	}
+	if (nullptr != GPCI.pColorBlendState) {
+		const auto& PCBSCI = *GPCI.pColorBlendState;
+		H.Add(PCBSCI.logicOpEnable).Add(PCBSCI.logicOp);
+		for (uint32_t i = 0; i < PCBSCI.attachmentCount; ++i) { H.Add(PCBSCI.pAttachments[i]); }
+	}
+	if (nullptr != GPCI.pDynamicState) {
+		for (uint32_t i = 0; i < GPCI.pDynamicState->dynamicStateCount; ++i) { H.Add(GPCI.pDynamicState->pDynamicStates[i]); }
+	}
+	H.Add(GPCI.layout).Add(GPCI.renderPass).Add(GPCI.subpass);
+	return H.Get();
+}
+
+//!< Builds graphics pipeline permutations from PipelineState
+//!< The first registered permutation becomes the base pipeline (ALLOW_DERIVATIVES), the others are created as its derivatives concurrently, sharing one VkPipelineCache
+class PipelineFactory
+{
+public:
+	PipelineFactory(const VkDevice Dev, const VkPipelineCache PC, const VkPipelineLayout PL, const VkRenderPass RP, const VkShaderModule VS, const VkShaderModule FS)
+		: Device(Dev), PipelineCache(PC), PipelineLayout(PL), RenderPass(RP), VertexShader(VS), FragmentShader(FS) {}
+
+	//!< Returns index of the permutation, identical create infos share one index
+	uint32_t Add(const PipelineState& PS) {
+		uint64_t Hash = 0;
+		WithCreateInfo(PS, 0, VK_NULL_HANDLE, [&](const VkGraphicsPipelineCreateInfo& GPCI) { Hash = HashCreateInfo(GPCI); });
+		const auto It = Indices.find(Hash);
+		if (Indices.end() != It) {
+			++DuplicateCount;
+			return It->second;
+		}
+		const auto Index = static_cast<uint32_t>(States.size());
+		Indices.emplace(Hash, Index);
+		States.push_back(PS);
+		return Index;
+	}
+
+	//!< Creates the registered permutations not built yet, up to index Count (exclusive), returns elapsed milliseconds
+	//!< Already built pipelines stay valid, so the ones needed first can be built ahead and the rest later (do not Add() in between)
+	double Build(ThreadPool& Pool, const uint32_t ThreadCount, const size_t Count = (std::numeric_limits<size_t>::max)()) {
+		const auto Begin = std::chrono::steady_clock::now();
+		Pipelines.resize(States.size());
+		const auto End = (std::min)(Count, States.size());
+		if (0 == BuiltCount && End > 0) {
+			Create(0, VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT, VK_NULL_HANDLE);
+			BuiltCount = 1;
+		}
+		if (End > BuiltCount) {
+			const auto Base = Pipelines[0].Get();
+			const auto First = BuiltCount;
+			Pool.ParallelFor(End - First, ThreadCount, [&](const size_t i) {
+				Create(static_cast<uint32_t>(First + i), VK_PIPELINE_CREATE_DERIVATIVE_BIT, Base);
+			});
+			BuiltCount = End;
+		}
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Begin).count();
+	}
+
+	size_t GetCount() const { return States.size(); }
+	size_t GetDuplicateCount() const { return DuplicateCount; }
+	VkPipeline Get(const uint32_t Index) const { return Pipelines[Index]; }
+	const PipelineState& GetState(const uint32_t Index) const { return States[Index]; }
+	void Clear() { Pipelines.clear(); BuiltCount = 0; }
+	//!< For hot swapping, pipelines still referenced by in-flight frames are destroyed later
+	void Retire(DeletionQueue& DQ) {
+		for (auto& i : Pipelines) { DQ.Push(std::move(i)); }
+		Pipelines.clear();
+		BuiltCount = 0;
+	}
+
+	//!< Every combination of the permutation axes used by the materials
+	static std::vector<PipelineState> EnumeratePermutations() {
+		std::vector<PipelineState> PSs;
+		for (const auto Scale : { 1.0f, 0.5f }) {
+			for (const auto ColorMode : { 0, 1, 2 }) {
+				for (const auto Topology : { VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST }) {
+					for (const auto CullMode : { static_cast<VkCullModeFlags>(VK_CULL_MODE_BACK_BIT), static_cast<VkCullModeFlags>(VK_CULL_MODE_NONE) }) {
+						for (const auto BlendEnable : { VK_FALSE, VK_TRUE }) {
+							PSs.push_back({ Scale, ColorMode, Topology, CullMode, static_cast<VkBool32>(BlendEnable) });
+						}
+					}
+				}
+			}
+		}
+		return PSs;
+	}
+
+private:
+	void Create(const uint32_t Index, const VkPipelineCreateFlags Flags, const VkPipeline Base) {
+		WithCreateInfo(States[Index], Flags, Base, [&](const VkGraphicsPipelineCreateInfo& GPCI) {
+			VERIFY_SUCCEEDED(vkCreateGraphicsPipelines(Device, PipelineCache, 1, &GPCI, GetAllocationCallbacks(), Pipelines[Index].Put(Device)));
+		});
+	}
+
+	//!< Create info only lives during Fn
+	template<typename FN>
+	void WithCreateInfo(const PipelineState& PS, const VkPipelineCreateFlags Flags, const VkPipeline Base, FN Fn) const {
+		const struct { float Scale; int32_t InstanceGrid; float Depth; int32_t Layers; } VSData = { PS.Scale, PS.InstanceGrid, PS.Depth, PS.Layers };
+		const std::array<VkSpecializationMapEntry, 4> VSMEs = { {
+			{ 0, offsetof(decltype(VSData), Scale), sizeof(VSData.Scale) },
+			{ 2, offsetof(decltype(VSData), InstanceGrid), sizeof(VSData.InstanceGrid) },
+			{ 3, offsetof(decltype(VSData), Depth), sizeof(VSData.Depth) },
+			{ 4, offsetof(decltype(VSData), Layers), sizeof(VSData.Layers) },
+		} };
+		const VkSpecializationInfo VSI = { static_cast<uint32_t>(VSMEs.size()), VSMEs.data(), sizeof(VSData), &VSData };
+		const std::array<VkSpecializationMapEntry, 1> FSMEs = { { { 1, 0, sizeof(PS.ColorMode) } } };
+		const VkSpecializationInfo FSI = { static_cast<uint32_t>(FSMEs.size()), FSMEs.data(), sizeof(PS.ColorMode), &PS.ColorMode };
+		const std::array<VkPipelineShaderStageCreateInfo, 2> PSSCIs = {
+			VkPipelineShaderStageCreateInfo({ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_VERTEX_BIT, VertexShader, "main", &VSI }),
+			VkPipelineShaderStageCreateInfo({ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_FRAGMENT_BIT, FragmentShader, "main", &FSI }),
+		};
+
+		const uint32_t Binding = 0;
+		const std::array<VkVertexInputBindingDescription, 1> VIBDs = { {
+			{ Binding, sizeof(Vertex_PositionColorTexcoord), VK_VERTEX_INPUT_RATE_VERTEX },
+		} };
+		const std::array<VkVertexInputAttributeDescription, 3> VIADs = { {
+			{ 0, Binding, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex_PositionColorTexcoord, Position) },
+			{ 1, Binding, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Vertex_PositionColorTexcoord, Color) },
+			{ 2, Binding, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex_PositionColorTexcoord, Texcoord) },
+		} };
+		const VkPipelineVertexInputStateCreateInfo PVISCI = {
+			VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+			nullptr,
+			0,
+			static_cast<uint32_t>(VIBDs.size()), VIBDs.data(),
+			static_cast<uint32_t>(VIADs.size()), VIADs.data()
+		};
+
+		const VkPipelineInputAssemblyStateCreateInfo PIASCI = {
+			VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+			nullptr,
+			0,
+			PS.Topology,
+			VK_FALSE
+		};
+
+		const VkPipelineTessellationStateCreateInfo PTSCI = {
+			VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO,
+			nullptr,
+			0,
+			0
+		};
+
+		const VkPipelineViewportStateCreateInfo PVSCI = {
+			VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+			nullptr,
+			0,
+			1, nullptr,
+			1, nullptr
+		};
+
+		const VkPipelineRasterizationStateCreateInfo PRSCI = {
+			VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+			nullptr,
+			0,
+			VK_FALSE,
+			VK_FALSE,
+			VK_POLYGON_MODE_FILL,
+			PS.CullMode,
+			VK_FRONT_FACE_COUNTER_CLOCKWISE,
+			VK_FALSE, 0.0f, 0.0f, 0.0f,
+			1.0f
+		};
+
+		const VkPipelineMultisampleStateCreateInfo PMSCI = {
+			VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+			nullptr,
+			0,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_FALSE, 0.0f,
+			nullptr,
+			VK_FALSE, VK_FALSE
+		};
+
+		const VkPipelineDepthStencilStateCreateInfo PDSSCI = {
+			VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+			nullptr,
+			0,
+			PS.DepthTestEnable, PS.DepthWriteEnable, VK_COMPARE_OP_LESS_OR_EQUAL,
+			VK_FALSE,
+			VK_FALSE, { VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP, VK_COMPARE_OP_NEVER, 0, 0, 0 }, { VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP, VK_STENCIL_OP_KEEP, VK_COMPARE_OP_ALWAYS, 0, 0, 0 },
+			0.0f, 1.0f
+		};
+
+		const std::array<VkPipelineColorBlendAttachmentState, 1> PCBASs = {
+			{
+				PS.BlendEnable,
+				VK_BLEND_FACTOR_SRC_ALPHA, VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA, VK_BLEND_OP_ADD,
+				VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ONE, VK_BLEND_OP_ADD,
+				PS.ColorWriteEnable ? static_cast<VkColorComponentFlags>(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT) : 0,
+			},
+		};
+		const VkPipelineColorBlendStateCreateInfo PCBSCI = {
+			VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+			nullptr,
+			0,
+			VK_FALSE, VK_LOGIC_OP_COPY,
+			static_cast<uint32_t>(PCBASs.size()), PCBASs.data(),
+			{ 1.0f, 1.0f, 1.0f, 1.0f }
+		};
+
+		const std::array<VkDynamicState, 2> DSs = {
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR,
+		};
+		const VkPipelineDynamicStateCreateInfo PDSCI = {
+			VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+			nullptr,
+			0,
+			static_cast<uint32_t>(DSs.size()), DSs.data()
+		};
+
+		const VkGraphicsPipelineCreateInfo GPCI = {
+			VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+			nullptr,
+			Flags,
+			static_cast<uint32_t>(PSSCIs.size()), PSSCIs.data(),
+			&PVISCI,
+			&PIASCI,
+			&PTSCI,
+			&PVSCI,
+			&PRSCI,
+			&PMSCI,
+			&PDSSCI,
+			&PCBSCI,
+			&PDSCI,
+			PipelineLayout,
+			RenderPass, 0,
+			Base, -1
+		};
+		Fn(GPCI);
+	}
+
+	VkDevice Device;
+	VkPipelineCache PipelineCache;
+	VkPipelineLayout PipelineLayout;
+	VkRenderPass RenderPass;
+	VkShaderModule VertexShader;
+	VkShaderModule FragmentShader;
+
+	std::vector<PipelineState> States;
+	std::unordered_map<uint64_t, uint32_t> Indices;
+	std::vector<PipelineObject> Pipelines;
+	size_t DuplicateCount = 0;
+	size_t BuiltCount = 0;
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+
+#include "Common.h"
+#include "Handle.h"
+
+//!< Time spent inside (or waiting on) one kind of call
+struct BlockedTime
+{
+	void Add(const uint64_t NS) {
+		++Count;
+		Total += NS;
+		Max = (std::max)(Max, NS);
+	}
+	double GetAverageMS() const { return Count ? static_cast<double>(Total) / Count * 1.0e-6 : 0.0; }
+	double GetMaxMS() const { return static_cast<double>(Max) * 1.0e-6; }
+
+	uint64_t Count = 0;
+	uint64_t Total = 0;
+	uint64_t Max = 0;
+};
+struct PresentStats
+{
+	BlockedTime Acquire;
+	BlockedTime Present;
+};
+
+//!< Acquire and present of the swapchain
+//!< Threaded : a dedicated thread presents frame N and acquires the image of frame N + 1, the render thread only blocks when that image is not there yet
+//!< Otherwise vkAcquireNextImageKHR and vkQueuePresentKHR run on the calling thread as before (--sync-present)
+//!< The queue is shared with the render thread's vkQueueSubmit, every use of it goes through QueueMutex
+class PresentThread
+{
+public:
+	PresentThread(const VkDevice Dev, const VkSwapchainKHR SC, const VkQueue Q, std::mutex& QM, const uint32_t ImageCount, const bool Threaded)
+		: Device(Dev), Swapchain(SC), Queue(Q), QueueMutex(QM), IsThreaded(Threaded) {
+		const VkSemaphoreCreateInfo SCI = {
+			VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+			nullptr,
+			0
+		};
+		//!< Acquire N + 1 is issued after submit N, which the render thread only makes once the fence of N - 1 has signaled, so the semaphore of N - 1 is free again
+		AcquireSemaphores.resize(2);
+		for (auto& i : AcquireSemaphores) { VERIFY_SUCCEEDED(vkCreateSemaphore(Device, &SCI, GetAllocationCallbacks(), i.Put(Device))); }
+		//!< Per image, reused once the image has been presented and acquired again
+		RenderFinishedSemaphores.resize(ImageCount);
+		for (auto& i : RenderFinishedSemaphores) { VERIFY_SUCCEEDED(vkCreateSemaphore(Device, &SCI, GetAllocationCallbacks(), i.Put(Device))); }
+
+		if (IsThreaded) {
+			Thread = std::thread([this]() { Run(); });
+		}
+	}
+	~PresentThread() { Stop(); }
+
+	//!< Presents what has been requested, then joins
+	void Stop() {
+		if (!Thread.joinable()) { return; }
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			IsQuit = true;
+		}
+		CV.notify_all();
+		Thread.join();
+	}
+
+	//!< Render thread : image to record into, the submit waits on Acquired at COLOR_ATTACHMENT_OUTPUT and signals RenderFinished
+	uint32_t Acquire(VkSemaphore& Acquired, VkSemaphore& RenderFinished) {
+		const auto Begin = std::chrono::steady_clock::now();
+		Image Img;
+		if (IsThreaded) {
+			std::unique_lock<std::mutex> Lock(Mutex);
+			CV.wait(Lock, [this]() { return !AcquiredImages.empty(); });
+			Img = AcquiredImages.front();
+			AcquiredImages.pop_front();
+		} else {
+			Img = AcquireNext();
+		}
+		Stats.Acquire.Add(GetElapsedNS(Begin));
+		Acquired = Img.Semaphore;
+		RenderFinished = RenderFinishedSemaphores[Img.Index];
+		return Img.Index;
+	}
+	//!< Render thread : after the submit that signals the RenderFinished semaphore of Index
+	void Present(const uint32_t Index) {
+		const auto Begin = std::chrono::steady_clock::now();
+		if (IsThreaded) {
+			{
+				std::lock_guard<std::mutex> Lock(Mutex);
+				Requests.push_back(Index);
+			}
+			CV.notify_all();
+		} else {
+			PresentImage(Index);
+		}
+		Stats.Present.Add(GetElapsedNS(Begin));
+	}
+
+	//!< Called once, right after the first vkQueuePresentKHR has returned (on the present thread when threaded), set it before the first Present()
+	void SetOnFirstPresent(std::function<void()>&& Fn) { OnFirstPresent = std::move(Fn); }
+
+	bool GetIsThreaded() const { return IsThreaded; }
+	//!< Render thread blocked in Acquire() / Present()
+	const PresentStats& GetStats() const { return Stats; }
+	//!< Present thread inside vkAcquireNextImageKHR / vkQueuePresentKHR, valid after Stop()
+	const PresentStats& GetThreadStats() const { return ThreadStats; }
+
+private:
+	struct Image { uint32_t Index; VkSemaphore Semaphore; };
+
+	static uint64_t GetElapsedNS(const std::chrono::steady_clock::time_point& Begin) {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Begin).count();
+	}
+
+	Image AcquireNext() {
+		const VkSemaphore Semaphore = AcquireSemaphores[AcquireCount++ % AcquireSemaphores.size()];
+		uint32_t Index;
+		VERIFY_SUCCEEDED(vkAcquireNextImageKHR(Device, Swapchain, UINT64_MAX, Semaphore, VK_NULL_HANDLE, &Index));
+		return { Index, Semaphore };
+	}
+	void PresentImage(const uint32_t Index) {
+		const VkSemaphore Wait = RenderFinishedSemaphores[Index];
+		const VkPresentInfoKHR PresentInfo = {
+			VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+			nullptr,
+			1, &Wait,
+			1, &Swapchain, &Index,
+			nullptr
+		};
+		{
+			std::lock_guard<std::mutex> Lock(QueueMutex);
+			VERIFY_SUCCEEDED(vkQueuePresentKHR(Queue, &PresentInfo));
+		}
+		if (OnFirstPresent) {
+			OnFirstPresent();
+			OnFirstPresent = nullptr;
+		}
+	}
+
+	void Run() {
+		for (;;) {
+			{
+				std::lock_guard<std::mutex> Lock(Mutex);
+				if (IsQuit) { break; }
+			}
+			{
+				const auto Begin = std::chrono::steady_clock::now();
+				const auto Img = AcquireNext();
+				ThreadStats.Acquire.Add(GetElapsedNS(Begin));
+				{
+					std::lock_guard<std::mutex> Lock(Mutex);
+					AcquiredImages.push_back(Img);
+				}
+				CV.notify_all();
+			}
+			uint32_t Index;
+			{
+				std::unique_lock<std::mutex> Lock(Mutex);
+				CV.wait(Lock, [this]() { return IsQuit || !Requests.empty(); });
+				if (Requests.empty()) { break; }
+				Index = Requests.front();
+				Requests.pop_front();
+			}
+			{
+				const auto Begin = std::chrono::steady_clock::now();
+				PresentImage(Index);
+				ThreadStats.Present.Add(GetElapsedNS(Begin));
+			}
+		}
+	}
+
+	VkDevice Device;
+	VkSwapchainKHR Swapchain;
+	VkQueue Queue;
+	std::mutex& QueueMutex;
+	const bool IsThreaded;
+	std::vector<SemaphoreObject> AcquireSemaphores;
+	std::vector<SemaphoreObject> RenderFinishedSemaphores;
+	uint64_t AcquireCount = 0;
+	std::function<void()> OnFirstPresent;
+
+	std::thread Thread;
+	std::mutex Mutex;
+	std::condition_variable CV;
+	bool IsQuit = false;
+	std::deque<Image> AcquiredImages;
+	std::deque<uint32_t> Requests;
+
+	PresentStats Stats;
+	PresentStats ThreadStats;
+};
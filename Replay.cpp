@@ -0,0 +1,390 @@
+#include <iostream>
+#include <cassert>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "Common.h"
+#include "Handle.h"
+#include "PipelineFactory.h"
+#include "Texture.h"
+#include "Offscreen.h"
+#include "Capture.h"
+
+//!< Re-executes a capture of VK (--capture) offscreen, as fast as possible or at the recorded pacing
+//!< Every frame waits for the previous one like VK does, so the result is comparable between devices (lavapipe included)
+int main(int argc, char* argv[])
+{
+	//!< Options
+	std::string CapturePath;
+	std::string DeviceFilter;		//!< Substring of the device name, e.g. "llvmpipe" to force lavapipe
+	uint32_t Loops = 1;				//!< Times the captured frames are replayed
+	auto IsPaced = false;			//!< Wait for the recorded frame times instead of submitting back to back
+	for (auto i = 1; i < argc; ++i) {
+		const std::string Arg = argv[i];
+		const auto HasValue = i + 1 < argc;
+		if ("--device" == Arg && HasValue) { DeviceFilter = argv[++i]; }
+		else if ("--loops" == Arg && HasValue) { Loops = (std::max)(1, std::atoi(argv[++i])); }
+		else if ("--paced" == Arg) { IsPaced = true; }
+		else if ('-' != Arg[0] && CapturePath.empty()) { CapturePath = Arg; }
+		else { std::cerr << "Unknown option : " << Arg << std::endl; return 2; }
+	}
+	if (CapturePath.empty()) {
+		std::cerr << "Usage : Replay <capture> [--device <name>] [--loops <count>] [--paced]" << std::endl;
+		return 2;
+	}
+
+	CaptureReader Capture;
+	if (!Capture.Load(CapturePath)) {
+		std::cerr << "Cannot read " << CapturePath << std::endl;
+		return 2;
+	}
+	std::cout << "Capture : Frames = " << Capture.Frames.size() << ", Buffers = " << Capture.Buffers.size() << ", Textures = " << Capture.Textures.size() << ", Pipelines = " << Capture.Pipelines.size() << ", Target = " << Capture.Width << " x " << Capture.Height << std::endl;
+	if (Capture.Frames.empty()) { return 0; }
+	const auto HasStage = [&](const VkShaderStageFlagBits Stage) { return std::any_of(Capture.Shaders.cbegin(), Capture.Shaders.cend(), [&](const CaptureReader::Shader& rhs) { return Stage == rhs.Stage; }); };
+	if (!HasStage(VK_SHADER_STAGE_VERTEX_BIT) || !HasStage(VK_SHADER_STAGE_FRAGMENT_BIT)) {
+		std::cerr << "Capture has no vertex and fragment shader" << std::endl;
+		return 2;
+	}
+
+	//!< Instance (no surface, everything is rendered offscreen)
+	VkInstance Instance;
+	{
+		uint32_t APIVersion;
+		vkEnumerateInstanceVersion(&APIVersion);
+		const VkApplicationInfo AI = {
+			VK_STRUCTURE_TYPE_APPLICATION_INFO,
+			nullptr,
+			"Replay", 0,
+			"EngineName", 0,
+			APIVersion
+		};
+		const VkInstanceCreateInfo ICI = {
+			VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+			nullptr,
+			0,
+			&AI,
+			0, nullptr,
+			0, nullptr
+		};
+		VERIFY_SUCCEEDED(vkCreateInstance(&ICI, GetAllocationCallbacks(), &Instance));
+	}
+
+	//!< Physical device
+	VkPhysicalDevice PhysicalDevice = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties PDP;
+	{
+		uint32_t Count = 0;
+		VERIFY_SUCCEEDED(vkEnumeratePhysicalDevices(Instance, &Count, nullptr));
+		std::vector<VkPhysicalDevice> PDs(Count);
+		VERIFY_SUCCEEDED(vkEnumeratePhysicalDevices(Instance, &Count, PDs.data()));
+		for (const auto i : PDs) {
+			vkGetPhysicalDeviceProperties(i, &PDP);
+			if (DeviceFilter.empty() || std::string::npos != std::string(PDP.deviceName).find(DeviceFilter)) {
+				PhysicalDevice = i;
+				break;
+			}
+		}
+		if (VK_NULL_HANDLE == PhysicalDevice) {
+			std::cerr << "No device matches \"" << DeviceFilter << "\"" << std::endl;
+			return 2;
+		}
+		std::cout << "Device = " << PDP.deviceName << std::endl;
+	}
+
+	//!< Device
+	uint32_t QueueFamilyIndex = 0xffff;
+	uint32_t TimestampValidBits = 0;
+	VkDevice Device;
+	VkQueue Queue;
+	{
+		uint32_t Count = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &Count, nullptr);
+		std::vector<VkQueueFamilyProperties> QFPs(Count);
+		vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &Count, QFPs.data());
+		for (uint32_t i = 0; i < QFPs.size(); ++i) {
+			if (VK_QUEUE_GRAPHICS_BIT & QFPs[i].queueFlags) {
+				QueueFamilyIndex = i;
+				TimestampValidBits = QFPs[i].timestampValidBits;
+				break;
+			}
+		}
+		assert(0xffff != QueueFamilyIndex && "");
+
+		const std::array<float, 1> Priorities = { 0.5f };
+		const std::array<VkDeviceQueueCreateInfo, 1> DQCIs = { {
+			{ VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, nullptr, 0, QueueFamilyIndex, static_cast<uint32_t>(Priorities.size()), Priorities.data() },
+		} };
+		VkPhysicalDeviceFeatures PDF;
+		vkGetPhysicalDeviceFeatures(PhysicalDevice, &PDF);
+		const VkDeviceCreateInfo DCI = {
+			VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+			nullptr,
+			0,
+			static_cast<uint32_t>(DQCIs.size()), DQCIs.data(),
+			0, nullptr,
+			0, nullptr,
+			&PDF
+		};
+		VERIFY_SUCCEEDED(vkCreateDevice(PhysicalDevice, &DCI, GetAllocationCallbacks(), &Device));
+		vkGetDeviceQueue(Device, QueueFamilyIndex, 0, &Queue);
+	}
+
+	//!< Command
+	VkCommandPool CommandPool;
+	VkCommandBuffer CB;
+	VkFence Fence;
+	{
+		const VkCommandPoolCreateInfo CPCI = {
+			VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			nullptr,
+			VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+			QueueFamilyIndex
+		};
+		VERIFY_SUCCEEDED(vkCreateCommandPool(Device, &CPCI, GetAllocationCallbacks(), &CommandPool));
+		const VkCommandBufferAllocateInfo CBAI = {
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			nullptr,
+			CommandPool,
+			VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			1
+		};
+		VERIFY_SUCCEEDED(vkAllocateCommandBuffers(Device, &CBAI, &CB));
+		const VkFenceCreateInfo FCI = {
+			VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+			nullptr,
+			0
+		};
+		VERIFY_SUCCEEDED(vkCreateFence(Device, &FCI, GetAllocationCallbacks(), &Fence));
+	}
+	const auto SubmitAndWait = [&]() {
+		const std::array<VkSubmitInfo, 1> SIs = { {
+			{ VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr, 0, nullptr, nullptr, 1, &CB, 0, nullptr }
+		} };
+		VERIFY_SUCCEEDED(vkQueueSubmit(Queue, static_cast<uint32_t>(SIs.size()), SIs.data(), Fence));
+		VERIFY_SUCCEEDED(vkWaitForFences(Device, 1, &Fence, VK_TRUE, (std::numeric_limits<uint64_t>::max)()));
+		VERIFY_SUCCEEDED(vkResetFences(Device, 1, &Fence));
+	};
+	const VkCommandBufferBeginInfo CBBI = {
+		VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		nullptr,
+		VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		nullptr
+	};
+
+	{
+		DeletionQueue PendingDeletions;
+
+		//!< Textures (a compressed capture falls back to a checker on devices that cannot sample it)
+		std::unique_ptr<TextureManager> Textures(new TextureManager(PhysicalDevice, Device, PendingDeletions, static_cast<uint32_t>(Capture.Textures.size()) + 1, 64 * 1024 * 1024, 4 * 1024 * 1024));
+		std::vector<uint32_t> TextureIndices;
+		for (auto& i : Capture.Textures) {
+			if (!Textures->IsFormatSupported(i.Format)) {
+				std::cout << "Texture format " << i.Format << " is not supported, replaced with a checker" << std::endl;
+				i = CreateCheckerRGBA8(i.Width, i.Height, 32, { 0xff, 0xff, 0xff, 0xff }, { 0x40, 0x40, 0x40, 0xff });
+			}
+			TextureIndices.push_back(Textures->Register(std::move(i)));
+		}
+
+		OffscreenTarget Target(PhysicalDevice, Device, Capture.Width, Capture.Height);
+
+		//!< Buffers (host visible, contents as captured)
+		std::vector<BufferObject> Buffers(Capture.Buffers.size());
+		std::vector<DeviceMemoryObject> Memories(Capture.Buffers.size());
+		for (size_t i = 0; i < Capture.Buffers.size(); ++i) {
+			const auto& Src = Capture.Buffers[i];
+			void* Data;
+			CreateHostVisibleBuffer(Buffers[i], Memories[i], &Data, PhysicalDevice, Device, Src.Usage, (std::max)(static_cast<VkDeviceSize>(Src.Data.size()), static_cast<VkDeviceSize>(4)));
+			memcpy(Data, Src.Data.data(), Src.Data.size());
+		}
+
+		//!< Pipeline layout (same as VK)
+		PipelineLayoutObject PipelineLayout;
+		{
+			const std::array<VkDescriptorSetLayout, 1> DSLs = { Textures->GetDescriptorSetLayout() };
+			const VkPipelineLayoutCreateInfo PLCI = {
+				VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+				nullptr,
+				0,
+				static_cast<uint32_t>(DSLs.size()), DSLs.data(),
+				0, nullptr
+			};
+			VERIFY_SUCCEEDED(vkCreatePipelineLayout(Device, &PLCI, GetAllocationCallbacks(), PipelineLayout.Put(Device)));
+		}
+
+		//!< Pipelines from the captured SPIR-V and states
+		ShaderModuleObject VS, FS;
+		for (const auto& i : Capture.Shaders) {
+			auto& SM = VK_SHADER_STAGE_VERTEX_BIT == i.Stage ? VS : FS;
+			CreateShaderModule(SM.Put(Device), Device, i.Code.data(), i.Code.size() * sizeof(i.Code[0]));
+		}
+		PipelineCacheObject PipelineCache;
+		{
+			const VkPipelineCacheCreateInfo PCCI = {
+				VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+				nullptr,
+				0,
+				0, nullptr
+			};
+			VERIFY_SUCCEEDED(vkCreatePipelineCache(Device, &PCCI, GetAllocationCallbacks(), PipelineCache.Put(Device)));
+		}
+		PipelineFactory Pipelines(Device, PipelineCache, PipelineLayout, Target.GetRenderPass(), VS, FS);
+		std::vector<uint32_t> PipelineIndices;
+		for (const auto& i : Capture.Pipelines) { PipelineIndices.push_back(Pipelines.Add(i)); }
+		{
+			ThreadPool Pool;
+			Pipelines.Build(Pool, Pool.GetWorkerCount() + 1);
+		}
+
+		//!< Streaming is not part of the replay, every texture is made resident before the first frame
+		const auto TouchAll = [&]() { for (const auto i : TextureIndices) { Textures->Touch(i); } };
+		for (uint32_t i = 0; i < 256; ++i) {
+			if (std::all_of(TextureIndices.cbegin(), TextureIndices.cend(), [&](const uint32_t rhs) { return Textures->IsSampleable(rhs); })) { break; }
+			PendingDeletions.BeginFrame();
+			PendingDeletions.Collect(PendingDeletions.GetFrame() - 1);
+			VERIFY_SUCCEEDED(vkBeginCommandBuffer(CB, &CBBI)); {
+				TouchAll();
+				Textures->Update(CB);
+			} VERIFY_SUCCEEDED(vkEndCommandBuffer(CB));
+			SubmitAndWait();
+		}
+
+		//!< Timestamps
+		QueryPoolObject QueryPool;
+		const auto IsTimestampSupported = 0 != TimestampValidBits && VK_TRUE == PDP.limits.timestampComputeAndGraphics;
+		if (IsTimestampSupported) {
+			const VkQueryPoolCreateInfo QPCI = {
+				VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+				nullptr,
+				0,
+				VK_QUERY_TYPE_TIMESTAMP,
+				2,
+				0
+			};
+			VERIFY_SUCCEEDED(vkCreateQueryPool(Device, &QPCI, GetAllocationCallbacks(), QueryPool.Put(Device)));
+		}
+
+		//!< Replay
+		const auto FrameCount = static_cast<uint32_t>(Capture.Frames.size()) * Loops;
+		double FrameMS = 0.0, CPUFrameMS = 0.0, GPUFrameMS = 0.0, MaxFrameMS = 0.0;
+		uint64_t DrawCount = 0;
+		const auto ReplayBegin = std::chrono::steady_clock::now();
+		for (uint32_t l = 0; l < Loops; ++l) {
+			const auto LoopBegin = std::chrono::steady_clock::now();
+			for (size_t f = 0; f < Capture.Frames.size(); ++f) {
+				const auto& Frame = Capture.Frames[f];
+				const auto IsLast = Loops == l + 1 && Capture.Frames.size() == f + 1;
+				if (IsPaced) {
+					std::this_thread::sleep_until(LoopBegin + std::chrono::microseconds(Frame.Timestamp - Capture.Frames[0].Timestamp));
+				}
+
+				PendingDeletions.BeginFrame();
+				PendingDeletions.Collect(PendingDeletions.GetFrame() - 1);
+
+				const auto Begin = std::chrono::steady_clock::now();
+				VERIFY_SUCCEEDED(vkBeginCommandBuffer(CB, &CBBI)); {
+					TouchAll();
+					Textures->Update(CB);
+
+					if (IsTimestampSupported) {
+						vkCmdResetQueryPool(CB, QueryPool, 0, 2);
+						vkCmdWriteTimestamp(CB, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, QueryPool, 0);
+					}
+					VkClearValue CV;
+					CV.color = Capture.ClearColor;
+					const VkRenderPassBeginInfo RPBI = {
+						VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+						nullptr,
+						Target.GetRenderPass(),
+						Target.GetFramebuffer(),
+						{ { 0, 0 }, { Capture.Width, Capture.Height } },
+						1, &CV
+					};
+					vkCmdBeginRenderPass(CB, &RPBI, VK_SUBPASS_CONTENTS_INLINE); {
+						for (const auto& i : Frame.Commands) {
+							switch (i.Op) {
+							case Capture::OP::SET_VIEWPORT: vkCmdSetViewport(CB, 0, 1, &i.Viewport); break;
+							case Capture::OP::SET_SCISSOR: vkCmdSetScissor(CB, 0, 1, &i.Scissor); break;
+							case Capture::OP::BIND_PIPELINE: vkCmdBindPipeline(CB, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipelines.Get(PipelineIndices[i.Object])); break;
+							case Capture::OP::BIND_TEXTURE:
+							{
+								const auto DS = Textures->GetDescriptorSet(TextureIndices[i.Object]);
+								vkCmdBindDescriptorSets(CB, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout, 0, 1, &DS, 0, nullptr);
+								break;
+							}
+							case Capture::OP::BIND_VERTEX_BUFFER:
+							{
+								const VkBuffer VB = Buffers[i.Object];
+								vkCmdBindVertexBuffers(CB, 0, 1, &VB, &i.Offset);
+								break;
+							}
+							case Capture::OP::BIND_INDEX_BUFFER: vkCmdBindIndexBuffer(CB, Buffers[i.Object], i.Offset, i.IndexType); break;
+							case Capture::OP::DRAW: vkCmdDraw(CB, i.Draw.vertexCount, i.Draw.instanceCount, i.Draw.firstVertex, i.Draw.firstInstance); ++DrawCount; break;
+							case Capture::OP::DRAW_INDEXED: vkCmdDrawIndexed(CB, i.DrawIndexed.indexCount, i.DrawIndexed.instanceCount, i.DrawIndexed.firstIndex, i.DrawIndexed.vertexOffset, i.DrawIndexed.firstInstance); ++DrawCount; break;
+							case Capture::OP::DRAW_INDEXED_INDIRECT: vkCmdDrawIndexedIndirect(CB, Buffers[i.Object], i.Offset, i.DrawCount, i.Stride); DrawCount += i.DrawCount; break;
+							default: break;
+							}
+						}
+					} vkCmdEndRenderPass(CB);
+					if (IsTimestampSupported) {
+						vkCmdWriteTimestamp(CB, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, QueryPool, 1);
+					}
+					//!< The last frame is read back for the checksum
+					if (IsLast) { Target.ReadBack(CB); }
+				} VERIFY_SUCCEEDED(vkEndCommandBuffer(CB));
+				const std::array<VkSubmitInfo, 1> SIs = { {
+					{ VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr, 0, nullptr, nullptr, 1, &CB, 0, nullptr }
+				} };
+				VERIFY_SUCCEEDED(vkQueueSubmit(Queue, static_cast<uint32_t>(SIs.size()), SIs.data(), Fence));
+				const auto Submitted = std::chrono::steady_clock::now();
+				VERIFY_SUCCEEDED(vkWaitForFences(Device, 1, &Fence, VK_TRUE, (std::numeric_limits<uint64_t>::max)()));
+				VERIFY_SUCCEEDED(vkResetFences(Device, 1, &Fence));
+				const auto End = std::chrono::steady_clock::now();
+
+				const auto MS = std::chrono::duration<double, std::milli>(End - Begin).count();
+				FrameMS += MS;
+				MaxFrameMS = (std::max)(MaxFrameMS, MS);
+				CPUFrameMS += std::chrono::duration<double, std::milli>(Submitted - Begin).count();
+				if (IsTimestampSupported) {
+					std::array<uint64_t, 2> Timestamps;
+					VERIFY_SUCCEEDED(vkGetQueryPoolResults(Device, QueryPool, 0, static_cast<uint32_t>(Timestamps.size()), sizeof(Timestamps), Timestamps.data(), sizeof(Timestamps[0]), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+					const auto Mask = TimestampValidBits < 64 ? (1ull << TimestampValidBits) - 1 : ~0ull;
+					GPUFrameMS += static_cast<double>((Timestamps[1] - Timestamps[0]) & Mask) * PDP.limits.timestampPeriod * 1.0e-6;
+				}
+			}
+		}
+		const auto ElapsedMS = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - ReplayBegin).count();
+
+		//!< Same capture on the same device and driver must give the same checksum
+		const auto Checksum = Hasher().Add(Target.GetPixels(), static_cast<size_t>(Capture.Width) * Capture.Height * 4).Get();
+
+		std::cout << "Replay : Frames = " << FrameCount << " (" << Loops << " loops" << (IsPaced ? ", paced" : "") << "), Draws = " << DrawCount << std::endl;
+		std::cout << "\tFrame = " << FrameMS / FrameCount << " msec (Max = " << MaxFrameMS << ", CPU = " << CPUFrameMS / FrameCount << ", GPU = " << (IsTimestampSupported ? GPUFrameMS / FrameCount : -1.0) << ")" << std::endl;
+		std::cout << "\tThroughput = " << FrameCount * 1000.0 / ElapsedMS << " frames / sec" << std::endl;
+		std::cout << "\tChecksum = 0x" << std::hex << Checksum << std::dec << std::endl;
+
+		VERIFY_SUCCEEDED(vkDeviceWaitIdle(Device));
+		Textures.reset();
+		Pipelines.Clear();
+		PendingDeletions.Flush();
+	}
+
+	//!< Destruct
+	{
+		vkDestroyFence(Device, Fence, GetAllocationCallbacks());
+		vkFreeCommandBuffers(Device, CommandPool, 1, &CB);
+		vkDestroyCommandPool(Device, CommandPool, GetAllocationCallbacks());
+		vkDestroyDevice(Device, GetAllocationCallbacks());
+		vkDestroyInstance(Instance, GetAllocationCallbacks());
+	}
+
+	return 0;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+//!< Lock-free single producer / single consumer ring, N must be a power of 2
+template<typename T, size_t N>
+class SPSCRing
+{
+	static_assert(0 == (N & (N - 1)), "N must be power of 2");
+public:
+	//!< Producer only, returns false when full
+	bool Push(const T& rhs) {
+		const auto Tail = WriteIndex.load(std::memory_order_relaxed);
+		if (Tail - ReadIndex.load(std::memory_order_acquire) == N) { return false; }
+		Items[Tail & (N - 1)] = rhs;
+		WriteIndex.store(Tail + 1, std::memory_order_release);
+		return true;
+	}
+	//!< Consumer only, returns false when empty
+	bool Pop(T& rhs) {
+		const auto Head = ReadIndex.load(std::memory_order_relaxed);
+		if (Head == WriteIndex.load(std::memory_order_acquire)) { return false; }
+		rhs = Items[Head & (N - 1)];
+		ReadIndex.store(Head + 1, std::memory_order_release);
+		return true;
+	}
+	bool Empty() const { return ReadIndex.load(std::memory_order_acquire) == WriteIndex.load(std::memory_order_acquire); }
+
+private:
+	//!< Indices live on separate cache lines so producer and consumer do not false share
+	alignas(64) std::atomic<size_t> WriteIndex{ 0 };
+	alignas(64) std::atomic<size_t> ReadIndex{ 0 };
+	alignas(64) std::array<T, N> Items;
+};
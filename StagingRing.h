@@ -0,0 +1,84 @@
+#pragma once
+
+#include <deque>
+#include <cstring>
+
+#include "Common.h"
+#include "Handle.h"
+
+//!< Persistently mapped host visible buffer handed out as a ring, regions are reclaimed once the frame that consumed them has completed
+class StagingRing
+{
+public:
+	StagingRing(const VkPhysicalDevice PD, const VkDevice Dev, const VkDeviceSize Size) : Device(Dev), Capacity(Size) {
+		const VkBufferCreateInfo BCI = {
+			VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			nullptr,
+			0,
+			Size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_SHARING_MODE_EXCLUSIVE,
+			0, nullptr
+		};
+		VERIFY_SUCCEEDED(vkCreateBuffer(Device, &BCI, GetAllocationCallbacks(), Buffer.Put(Device)));
+
+		VkMemoryRequirements MR;
+		vkGetBufferMemoryRequirements(Device, Buffer, &MR);
+		const VkMemoryAllocateInfo MAI = {
+			VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			nullptr,
+			MR.size,
+			GetMemoryTypeIndex(PD, MR, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+		};
+		VERIFY_SUCCEEDED(vkAllocateMemory(Device, &MAI, GetAllocationCallbacks(), Memory.Put(Device)));
+		VERIFY_SUCCEEDED(vkBindBufferMemory(Device, Buffer, Memory, 0));
+		VERIFY_SUCCEEDED(vkMapMemory(Device, Memory, 0, VK_WHOLE_SIZE, static_cast<VkMemoryMapFlags>(0), &Data));
+	}
+	~StagingRing() {
+		if (VK_NULL_HANDLE != Memory.Get()) { vkUnmapMemory(Device, Memory); }
+	}
+
+	VkBuffer GetBuffer() const { return Buffer; }
+	VkDeviceSize GetCapacity() const { return Capacity; }
+
+	//!< Copies Size bytes into the ring, returns false (and leaves Offset untouched) when there is no room until older frames complete
+	bool Write(const void* Src, const VkDeviceSize Size, const VkDeviceSize Align, const uint64_t Frame, VkDeviceSize& Offset) {
+		if (Size > Capacity) { return false; }
+		auto Begin = (Head + Align - 1) / Align * Align;
+		//!< Do not straddle the end of the buffer, skip to the beginning instead
+		if (Begin % Capacity + Size > Capacity) { Begin = (Begin / Capacity + 1) * Capacity; }
+		if (Begin + Size - Tail > Capacity) { return false; }
+		Offset = Begin % Capacity;
+		memcpy(reinterpret_cast<uint8_t*>(Data) + Offset, Src, static_cast<size_t>(Size));
+		Head = Begin + Size;
+		if (!Regions.empty() && Regions.back().Frame == Frame) {
+			Regions.back().End = Head;
+		} else {
+			Regions.push_back({ Frame, Head });
+		}
+		return true;
+	}
+	//!< Everything written up to CompletedFrame has been consumed by the GPU
+	void Reclaim(const uint64_t CompletedFrame) {
+		while (!Regions.empty() && Regions.front().Frame <= CompletedFrame) {
+			Tail = Regions.front().End;
+			Regions.pop_front();
+		}
+	}
+
+private:
+	struct Region {
+		uint64_t Frame;
+		VkDeviceSize End;
+	};
+
+	VkDevice Device;
+	VkDeviceSize Capacity;
+	BufferObject Buffer;
+	DeviceMemoryObject Memory;
+	void* Data = nullptr;
+	//!< Monotonic positions, offset in buffer is position % Capacity
+	VkDeviceSize Head = 0;
+	VkDeviceSize Tail = 0;
+	std::deque<Region> Regions;
+};
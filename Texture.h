@@ -0,0 +1,499 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <string>
+#include <cmath>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+
+#include "Common.h"
+#include "Handle.h"
+#include "StagingRing.h"
+
+//!< Pixel data of every level (compressed) or of the base level only (uncompressed, the rest is generated on the GPU)
+struct TextureSource
+{
+	VkFormat Format = VK_FORMAT_R8G8B8A8_UNORM;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	uint32_t MipLevels = 1;
+	std::vector<std::vector<uint8_t>> Levels;
+
+	bool IsCompressed() const { return VK_FORMAT_R8G8B8A8_UNORM != Format; }
+};
+
+static TextureSource CreateCheckerRGBA8(const uint32_t Width, const uint32_t Height, const uint32_t Cell, const std::array<uint8_t, 4>& Color0, const std::array<uint8_t, 4>& Color1)
+{
+	TextureSource TS;
+	TS.Width = Width;
+	TS.Height = Height;
+	TS.MipLevels = static_cast<uint32_t>(std::log2((std::max)(Width, Height))) + 1;
+	TS.Levels.resize(1);
+	auto& Texels = TS.Levels[0];
+	Texels.resize(Width * Height * 4);
+	for (uint32_t y = 0; y < Height; ++y) {
+		for (uint32_t x = 0; x < Width; ++x) {
+			const auto& Color = ((x / Cell + y / Cell) & 1) ? Color1 : Color0;
+			std::copy(Color.cbegin(), Color.cend(), Texels.begin() + (y * Width + x) * 4);
+		}
+	}
+	return TS;
+}
+
+//!< KTX 1.1 with ETC2 / ASTC 4x4 payload (e.g. made by toktx or etcpak offline), returns false on anything else
+//!< Levels are copied as whole extents, so a header or level size that does not match the image is rejected as well
+static bool LoadKTX(const std::string& Path, TextureSource& TS)
+{
+	std::ifstream In(Path.c_str(), std::ios::in | std::ios::binary);
+	if (In.fail()) { return false; }
+
+	static const std::array<uint8_t, 12> Identifier = { 0xab, 'K', 'T', 'X', ' ', '1', '1', 0xbb, '\r', '\n', 0x1a, '\n' };
+	struct Header {
+		uint8_t Identifier[12];
+		uint32_t Endianness, GLType, GLTypeSize, GLFormat, GLInternalFormat, GLBaseInternalFormat, PixelWidth, PixelHeight, PixelDepth, NumberOfArrayElements, NumberOfFaces, NumberOfMipmapLevels, BytesOfKeyValueData;
+	} KH;
+	In.read(reinterpret_cast<char*>(&KH), sizeof(KH));
+	if (In.fail() || 0 != memcmp(KH.Identifier, Identifier.data(), Identifier.size()) || 0x04030201 != KH.Endianness) { return false; }
+
+	//!< Bytes per 4x4 block
+	uint32_t BlockSize = 16;
+	switch (KH.GLInternalFormat) {
+	case 0x9274: TS.Format = VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK; BlockSize = 8; break;		//!< GL_COMPRESSED_RGB8_ETC2
+	case 0x9275: TS.Format = VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK; BlockSize = 8; break;		//!< GL_COMPRESSED_SRGB8_ETC2
+	case 0x9276: TS.Format = VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK; BlockSize = 8; break;	//!< GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2
+	case 0x9278: TS.Format = VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK; break;					//!< GL_COMPRESSED_RGBA8_ETC2_EAC
+	case 0x9279: TS.Format = VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK; break;						//!< GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC
+	case 0x93b0: TS.Format = VK_FORMAT_ASTC_4x4_UNORM_BLOCK; break;							//!< GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+	case 0x93d0: TS.Format = VK_FORMAT_ASTC_4x4_SRGB_BLOCK; break;							//!< GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR
+	default: return false;
+	}
+	//!< Single 2D image only
+	if (0 == KH.PixelWidth || KH.PixelDepth > 1 || KH.NumberOfArrayElements > 1 || 1 != KH.NumberOfFaces) { return false; }
+	TS.Width = KH.PixelWidth;
+	TS.Height = (std::max)(KH.PixelHeight, 1u);
+	TS.MipLevels = (std::max)(KH.NumberOfMipmapLevels, 1u);
+	if (TS.MipLevels > static_cast<uint32_t>(std::log2((std::max)(TS.Width, TS.Height))) + 1) { return false; }
+
+	In.seekg(KH.BytesOfKeyValueData, std::ios_base::cur);
+	TS.Levels.resize(TS.MipLevels);
+	for (uint32_t Level = 0; Level < TS.MipLevels; ++Level) {
+		auto& i = TS.Levels[Level];
+		uint32_t ImageSize = 0;
+		In.read(reinterpret_cast<char*>(&ImageSize), sizeof(ImageSize));
+		const uint64_t W = (std::max)(TS.Width >> Level, 1u), H = (std::max)(TS.Height >> Level, 1u);
+		if (In.fail() || ImageSize != ((W + 3) / 4) * ((H + 3) / 4) * BlockSize) { return false; }
+		i.resize(ImageSize);
+		In.read(reinterpret_cast<char*>(i.data()), ImageSize);
+		In.seekg(3 - ((ImageSize + 3) % 4), std::ios_base::cur);
+	}
+	return !In.fail();
+}
+
+//!< Streams textures into device local images within a per frame upload budget and keeps the resident total under a cap by evicting least recently used ones
+//!< Compressed (ETC2 / ASTC) textures stream their levels smallest first, uncompressed ones upload the base level and blit the rest of the chain on the GPU
+class TextureManager
+{
+public:
+	struct Stats {
+		VkDeviceSize ResidentBytes = 0;
+		uint32_t ResidentCount = 0;
+		VkDeviceSize UploadedBytes = 0;
+		uint32_t Evictions = 0;
+		uint32_t ResidentFailures = 0;	//!< Did not fit even after evicting everything not used this frame
+		double UploadSeconds = 0.0;	//!< Wall time while any upload was in flight
+
+		double GetThroughputMBps() const { return UploadSeconds > 0.0 ? UploadedBytes / UploadSeconds / (1024.0 * 1024.0) : 0.0; }
+	};
+
+	TextureManager(const VkPhysicalDevice PD, const VkDevice Dev, DeletionQueue& DQ, const uint32_t MaxTextures, const VkDeviceSize ResidentCap, const VkDeviceSize FrameBudget)
+		: PhysicalDevice(PD), Device(Dev), Deletions(DQ), ResidentBudget(ResidentCap), FrameUploadBudget(FrameBudget), Staging(new StagingRing(PD, Dev, FrameBudget * 3)) {
+		VkPhysicalDeviceFeatures PDF;
+		vkGetPhysicalDeviceFeatures(PhysicalDevice, &PDF);
+		IsETC2Supported = VK_TRUE == PDF.textureCompressionETC2;
+		IsASTCSupported = VK_TRUE == PDF.textureCompressionASTC_LDR;
+
+		VkFormatProperties FP;
+		vkGetPhysicalDeviceFormatProperties(PhysicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &FP);
+		const VkFormatFeatureFlags Blit = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		IsBlitSupported = (FP.optimalTilingFeatures & Blit) == Blit;
+
+		const VkSamplerCreateInfo SCI = {
+			VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+			nullptr,
+			0,
+			VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR,
+			VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT,
+			0.0f,
+			VK_FALSE, 1.0f,
+			VK_FALSE, VK_COMPARE_OP_NEVER,
+			0.0f, 16.0f,
+			VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK,
+			VK_FALSE
+		};
+		VERIFY_SUCCEEDED(vkCreateSampler(Device, &SCI, GetAllocationCallbacks(), Sampler.Put(Device)));
+
+		const std::array<VkDescriptorSetLayoutBinding, 1> DSLBs = { {
+			{ 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
+		} };
+		const VkDescriptorSetLayoutCreateInfo DSLCI = {
+			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			nullptr,
+			0,
+			static_cast<uint32_t>(DSLBs.size()), DSLBs.data()
+		};
+		VERIFY_SUCCEEDED(vkCreateDescriptorSetLayout(Device, &DSLCI, GetAllocationCallbacks(), DescriptorSetLayout.Put(Device)));
+
+		//!< One set per texture + default
+		const std::array<VkDescriptorPoolSize, 1> DPSs = { { { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MaxTextures + 1 } } };
+		const VkDescriptorPoolCreateInfo DPCI = {
+			VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			nullptr,
+			0,
+			MaxTextures + 1,
+			static_cast<uint32_t>(DPSs.size()), DPSs.data()
+		};
+		VERIFY_SUCCEEDED(vkCreateDescriptorPool(Device, &DPCI, GetAllocationCallbacks(), DescriptorPool.Put(Device)));
+
+		//!< 1x1 white, bound while the requested texture is not resident yet
+		TextureSource White;
+		White.Width = White.Height = 1;
+		White.Levels.push_back({ 0xff, 0xff, 0xff, 0xff });
+		DefaultTexture = Register(std::move(White));
+		Touch(DefaultTexture);
+	}
+
+	VkDescriptorSetLayout GetDescriptorSetLayout() const { return DescriptorSetLayout; }
+	const Stats& GetStats() const { return TextureStats; }
+	//!< The compression family of Format is enabled and the device reports sampling that format itself
+	bool IsFormatSupported(const VkFormat Format) const {
+		switch (Format) {
+		case VK_FORMAT_R8G8B8A8_UNORM: break;
+		case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_4x4_SRGB_BLOCK: if (!IsASTCSupported) { return false; } break;
+		default: if (!IsETC2Supported) { return false; } break;
+		}
+		VkFormatProperties FP;
+		vkGetPhysicalDeviceFormatProperties(PhysicalDevice, Format, &FP);
+		return 0 != (FP.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+	}
+
+	uint32_t Register(TextureSource&& TS) {
+		Textures.emplace_back(new Texture());
+		auto& Tex = *Textures.back();
+		Tex.Source = std::move(TS);
+		for (const auto& i : Tex.Source.Levels) { ReserveStaging(i.size()); }
+
+		const VkDescriptorSetLayout DSL = DescriptorSetLayout;
+		const VkDescriptorSetAllocateInfo DSAI = {
+			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			nullptr,
+			DescriptorPool,
+			1, &DSL
+		};
+		VERIFY_SUCCEEDED(vkAllocateDescriptorSets(Device, &DSAI, &Tex.DescriptorSet));
+		return static_cast<uint32_t>(Textures.size() - 1);
+	}
+	//!< Compressed KTX when the device can sample it, Fallback (RGBA8) otherwise
+	uint32_t Register(const std::string& KTXPath, TextureSource&& Fallback) {
+		TextureSource TS;
+		if (LoadKTX(KTXPath, TS) && IsFormatSupported(TS.Format)) {
+			return Register(std::move(TS));
+		}
+		return Register(std::move(Fallback));
+	}
+
+	//!< Mark as used by the frame being recorded, starts streaming if not resident
+	void Touch(const uint32_t Index) {
+		auto& Tex = *Textures[Index];
+		Tex.LastUsedFrame = Deletions.GetFrame();
+		if (!Tex.Image && Tex.LastUsedFrame >= Tex.RetryFrame) {
+			Tex.Requested = true;
+		}
+	}
+
+	//!< Set with the best resident levels of the texture, or the default one
+	VkDescriptorSet GetDescriptorSet(const uint32_t Index) const {
+		const auto& Tex = *Textures[Index];
+		return Tex.IsSampleable() ? Tex.DescriptorSet : Textures[DefaultTexture]->DescriptorSet;
+	}
+
+	bool IsSampleable(const uint32_t Index) const { return Textures[Index]->IsSampleable(); }
+	size_t GetCount() const { return Textures.size(); }
+	const TextureSource& GetSource(const uint32_t Index) const { return Textures[Index]->Source; }
+
+	//!< Call after the frame fence wait, records uploads (outside of render pass) into CB
+	void Update(const VkCommandBuffer CB) {
+		const auto Frame = Deletions.GetFrame();
+		Staging->Reclaim(Frame - 1);
+
+		//!< Wall time accounting for throughput
+		const auto Now = std::chrono::steady_clock::now();
+		if (IsUploading) { TextureStats.UploadSeconds += std::chrono::duration<double>(Now - LastUpdate).count(); }
+		LastUpdate = Now;
+		IsUploading = false;
+
+		VkDeviceSize Budget = FrameUploadBudget;
+		for (uint32_t i = 0; i < Textures.size(); ++i) {
+			auto& Tex = *Textures[i];
+			if (Tex.Requested && !Tex.Image) {
+				if (!MakeResident(i)) { continue; }
+			}
+			if (Tex.Image && Tex.ResidentMip > 0) {
+				Stream(CB, Tex, Budget);
+			}
+		}
+	}
+
+	void Clear() {
+		Textures.clear();
+		Staging.reset();
+		DescriptorPool.Reset();
+		DescriptorSetLayout.Reset();
+		Sampler.Reset();
+	}
+
+private:
+	struct Texture {
+		TextureSource Source;
+		ImageObject Image;
+		DeviceMemoryObject Memory;
+		ImageViewObject View;
+		VkDescriptorSet DescriptorSet = VK_NULL_HANDLE;
+		VkDeviceSize Size = 0;
+		uint32_t ResidentMip = 0;	//!< Finest uploaded level, == MipLevels while nothing is uploaded
+		uint64_t LastUsedFrame = 0;
+		uint64_t RetryFrame = 0;	//!< Not requested again before this frame after failing to become resident
+		bool Requested = false;
+
+		bool IsSampleable() const { return Image && ResidentMip < Source.MipLevels; }
+	};
+
+	//!< A level is written in one piece, the ring has to hold it wherever its head is (hence twice the size)
+	void ReserveStaging(const VkDeviceSize Size) {
+		if (Staging->GetCapacity() >= Size * 2) { return; }
+		//!< Previous frames may still copy from the old ring
+		std::shared_ptr<StagingRing> Old(std::move(Staging));
+		Deletions.Push([Old]() {});
+		Staging.reset(new StagingRing(PhysicalDevice, Device, Size * 2));
+	}
+
+	//!< Create image and memory, evicting least recently used textures while over budget
+	bool MakeResident(const uint32_t Index) {
+		auto& Tex = *Textures[Index];
+		auto& TS = Tex.Source;
+		if (!TS.IsCompressed() && !IsBlitSupported) {
+			TS.MipLevels = 1;
+		}
+
+		const VkImageCreateInfo ICI = {
+			VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			nullptr,
+			0,
+			VK_IMAGE_TYPE_2D,
+			TS.Format,
+			{ TS.Width, TS.Height, 1 },
+			TS.MipLevels,
+			1,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | static_cast<VkImageUsageFlags>(TS.IsCompressed() ? 0 : VK_IMAGE_USAGE_TRANSFER_SRC_BIT),
+			VK_SHARING_MODE_EXCLUSIVE,
+			0, nullptr,
+			VK_IMAGE_LAYOUT_UNDEFINED
+		};
+		ImageObject Image;
+		VERIFY_SUCCEEDED(vkCreateImage(Device, &ICI, GetAllocationCallbacks(), Image.Put(Device)));
+		VkMemoryRequirements MR;
+		vkGetImageMemoryRequirements(Device, Image, &MR);
+
+		while (TextureStats.ResidentBytes + MR.size > ResidentBudget) {
+			if (!EvictLeastRecentlyUsed()) {
+				//!< Back off instead of creating and destroying the image every frame
+				Tex.Requested = false;
+				Tex.RetryFrame = Deletions.GetFrame() + RetryInterval;
+				++TextureStats.ResidentFailures;
+				return false;
+			}
+		}
+
+		const VkMemoryAllocateInfo MAI = {
+			VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			nullptr,
+			MR.size,
+			GetMemoryTypeIndex(PhysicalDevice, MR, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+		};
+		VERIFY_SUCCEEDED(vkAllocateMemory(Device, &MAI, GetAllocationCallbacks(), Tex.Memory.Put(Device)));
+		VERIFY_SUCCEEDED(vkBindImageMemory(Device, Image, Tex.Memory, 0));
+
+		Tex.Image = std::move(Image);
+		Tex.Size = MR.size;
+		Tex.ResidentMip = TS.MipLevels;
+		Tex.Requested = false;
+		TextureStats.ResidentBytes += Tex.Size;
+		++TextureStats.ResidentCount;
+		return true;
+	}
+
+	bool EvictLeastRecentlyUsed() {
+		Texture* LRU = nullptr;
+		for (uint32_t i = 0; i < Textures.size(); ++i) {
+			auto& Tex = *Textures[i];
+			//!< Anything touched this frame (and the default) stays
+			if (i == DefaultTexture || !Tex.Image || Tex.LastUsedFrame >= Deletions.GetFrame()) { continue; }
+			if (nullptr == LRU || Tex.LastUsedFrame < LRU->LastUsedFrame) { LRU = &Tex; }
+		}
+		if (nullptr == LRU) { return false; }
+
+		//!< Previous frames may still sample it
+		Deletions.Push(std::move(LRU->View));
+		Deletions.Push(std::move(LRU->Image));
+		Deletions.Push(std::move(LRU->Memory));
+		TextureStats.ResidentBytes -= LRU->Size;
+		--TextureStats.ResidentCount;
+		++TextureStats.Evictions;
+		LRU->Size = 0;
+		LRU->ResidentMip = LRU->Source.MipLevels;
+		return true;
+	}
+
+	void Barrier(const VkCommandBuffer CB, const VkImage Image, const uint32_t BaseMip, const uint32_t MipCount, const VkImageLayout Old, const VkImageLayout New, const VkAccessFlags SrcAF, const VkAccessFlags DstAF, const VkPipelineStageFlags SrcPSF, const VkPipelineStageFlags DstPSF) {
+		const std::array<VkImageMemoryBarrier, 1> IMBs = { {
+			{
+				VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				nullptr,
+				SrcAF, DstAF,
+				Old, New,
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+				Image,
+				{ VK_IMAGE_ASPECT_COLOR_BIT, BaseMip, MipCount, 0, 1 }
+			}
+		} };
+		vkCmdPipelineBarrier(CB, SrcPSF, DstPSF, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(IMBs.size()), IMBs.data());
+	}
+
+	void Stream(const VkCommandBuffer CB, Texture& Tex, VkDeviceSize& Budget) {
+		const auto& TS = Tex.Source;
+		const auto Frame = Deletions.GetFrame();
+		const auto PrevResidentMip = Tex.ResidentMip;
+		if (TS.IsCompressed()) {
+			//!< Smallest level first, so a blurry version shows up as soon as possible (a level over the whole budget goes in a frame with nothing else to upload)
+			while (Tex.ResidentMip > 0) {
+				const auto Level = Tex.ResidentMip - 1;
+				const auto& Data = TS.Levels[Level];
+				if (Data.size() > Budget && Budget != FrameUploadBudget) { break; }
+				VkDeviceSize Offset;
+				if (!Staging->Write(Data.data(), Data.size(), 16, Frame, Offset)) { break; }
+				Budget -= (std::min)(Budget, static_cast<VkDeviceSize>(Data.size()));
+				CopyLevel(CB, Tex, Level, Offset);
+				Barrier(CB, Tex.Image, Level, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+				Tex.ResidentMip = Level;
+				TextureStats.UploadedBytes += Data.size();
+			}
+		} else {
+			//!< Whole base level at once (a frame with nothing else to upload may exceed the budget), then blit down the chain
+			const auto& Data = TS.Levels[0];
+			if (Data.size() > Budget && Budget != FrameUploadBudget) { return; }
+			VkDeviceSize Offset;
+			if (!Staging->Write(Data.data(), Data.size(), 16, Frame, Offset)) { return; }
+			Budget -= (std::min)(Budget, static_cast<VkDeviceSize>(Data.size()));
+			CopyLevel(CB, Tex, 0, Offset);
+			GenerateMips(CB, Tex);
+			Tex.ResidentMip = 0;
+			TextureStats.UploadedBytes += Data.size();
+		}
+		if (PrevResidentMip != Tex.ResidentMip) {
+			IsUploading = true;
+			UpdateView(Tex);
+		}
+	}
+
+	void CopyLevel(const VkCommandBuffer CB, const Texture& Tex, const uint32_t Level, const VkDeviceSize Offset) {
+		const auto& TS = Tex.Source;
+		Barrier(CB, Tex.Image, Level, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		const std::array<VkBufferImageCopy, 1> BICs = { {
+			{
+				Offset,
+				0, 0,
+				{ VK_IMAGE_ASPECT_COLOR_BIT, Level, 0, 1 },
+				{ 0, 0, 0 },
+				{ (std::max)(TS.Width >> Level, 1u), (std::max)(TS.Height >> Level, 1u), 1 }
+			}
+		} };
+		vkCmdCopyBufferToImage(CB, Staging->GetBuffer(), Tex.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(BICs.size()), BICs.data());
+	}
+
+	//!< Level 0 is in TRANSFER_DST, every level ends up SHADER_READ_ONLY
+	void GenerateMips(const VkCommandBuffer CB, const Texture& Tex) {
+		const auto& TS = Tex.Source;
+		for (uint32_t i = 1; i < TS.MipLevels; ++i) {
+			Barrier(CB, Tex.Image, i - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+			Barrier(CB, Tex.Image, i, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+			const std::array<VkImageBlit, 1> IBs = { {
+				{
+					{ VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 0, 1 },
+					{ { 0, 0, 0 }, { static_cast<int32_t>((std::max)(TS.Width >> (i - 1), 1u)), static_cast<int32_t>((std::max)(TS.Height >> (i - 1), 1u)), 1 } },
+					{ VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 },
+					{ { 0, 0, 0 }, { static_cast<int32_t>((std::max)(TS.Width >> i, 1u)), static_cast<int32_t>((std::max)(TS.Height >> i, 1u)), 1 } },
+				}
+			} };
+			vkCmdBlitImage(CB, Tex.Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, Tex.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(IBs.size()), IBs.data(), VK_FILTER_LINEAR);
+		}
+		//!< All but the last level are TRANSFER_SRC now
+		if (TS.MipLevels > 1) {
+			Barrier(CB, Tex.Image, 0, TS.MipLevels - 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		}
+		Barrier(CB, Tex.Image, TS.MipLevels - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	}
+
+	//!< View only covers the resident levels, the old one may still be in use by previous frames
+	void UpdateView(Texture& Tex) {
+		const auto& TS = Tex.Source;
+		Deletions.Push(std::move(Tex.View));
+		const VkImageViewCreateInfo IVCI = {
+			VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			nullptr,
+			0,
+			Tex.Image,
+			VK_IMAGE_VIEW_TYPE_2D,
+			TS.Format,
+			{ VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, },
+			{ VK_IMAGE_ASPECT_COLOR_BIT, Tex.ResidentMip, TS.MipLevels - Tex.ResidentMip, 0, 1 }
+		};
+		VERIFY_SUCCEEDED(vkCreateImageView(Device, &IVCI, GetAllocationCallbacks(), Tex.View.Put(Device)));
+
+		const std::array<VkDescriptorImageInfo, 1> DIIs = { { { Sampler, Tex.View, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL } } };
+		const std::array<VkWriteDescriptorSet, 1> WDSs = { {
+			{
+				VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				nullptr,
+				Tex.DescriptorSet, 0, 0,
+				static_cast<uint32_t>(DIIs.size()), VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, DIIs.data(), nullptr, nullptr
+			}
+		} };
+		vkUpdateDescriptorSets(Device, static_cast<uint32_t>(WDSs.size()), WDSs.data(), 0, nullptr);
+	}
+
+	VkPhysicalDevice PhysicalDevice;
+	VkDevice Device;
+	DeletionQueue& Deletions;
+	VkDeviceSize ResidentBudget;
+	VkDeviceSize FrameUploadBudget;
+	static constexpr uint64_t RetryInterval = 60;
+	std::unique_ptr<StagingRing> Staging;
+	bool IsETC2Supported = false;
+	bool IsASTCSupported = false;
+	bool IsBlitSupported = false;
+
+	SamplerObject Sampler;
+	DescriptorSetLayoutObject DescriptorSetLayout;
+	DescriptorPoolObject DescriptorPool;
+	std::vector<std::unique_ptr<Texture>> Textures;
+	uint32_t DefaultTexture = 0;
+
+	Stats TextureStats;
+	bool IsUploading = false;
+	std::chrono::steady_clock::time_point LastUpdate;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+
+//!< Fixed set of worker threads consuming a job queue
+class ThreadPool
+{
+public:
+	explicit ThreadPool(const uint32_t Count = (std::max)(std::thread::hardware_concurrency(), 1u) - 1) {
+		for (uint32_t i = 0; i < Count; ++i) {
+			Workers.emplace_back([this]() { Run(); });
+		}
+	}
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			Quit = true;
+		}
+		CV.notify_all();
+		for (auto& i : Workers) { i.join(); }
+	}
+
+	uint32_t GetWorkerCount() const { return static_cast<uint32_t>(Workers.size()); }
+
+	void Enqueue(std::function<void()>&& Job) {
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			Jobs.push_back(std::move(Job));
+			++Unfinished;
+		}
+		CV.notify_one();
+	}
+	void Wait() {
+		std::unique_lock<std::mutex> Lock(Mutex);
+		DoneCV.wait(Lock, [this]() { return 0 == Unfinished; });
+	}
+
+	//!< Runs Fn(i) for i in [0, Count) on ThreadCount threads, the calling thread being one of them
+	template<typename FN>
+	void ParallelFor(const size_t Count, const uint32_t ThreadCount, FN Fn) {
+		std::atomic<size_t> Next(0);
+		const auto Worker = [&]() {
+			for (auto i = Next++; i < Count; i = Next++) { Fn(i); }
+		};
+		const auto Helpers = (std::min)(ThreadCount > 0 ? ThreadCount - 1 : 0, GetWorkerCount());
+		for (uint32_t i = 0; i < Helpers; ++i) { Enqueue(Worker); }
+		Worker();
+		Wait();
+	}
+
+private:
+	void Run() {
+		for (;;) {
+			std::function<void()> Job;
+			{
+				std::unique_lock<std::mutex> Lock(Mutex);
+				CV.wait(Lock, [this]() { return Quit || !Jobs.empty(); });
+				if (Jobs.empty()) { return; }
+				Job = std::move(Jobs.front());
+				Jobs.pop_front();
+			}
+			Job();
+			{
+				std::lock_guard<std::mutex> Lock(Mutex);
+				--Unfinished;
+			}
+			DoneCV.notify_all();
+		}
+	}
+
+	std::vector<std::thread> Workers;
+	std::deque<std::function<void()>> Jobs;
+	std::mutex Mutex;
+	std::condition_variable CV;
+	std::condition_variable DoneCV;
+	size_t Unfinished = 0;
+	bool Quit = false;
+};
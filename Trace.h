@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+
+//!< Collects timed phases from any thread and writes them in the Chrome trace event format (chrome://tracing, Perfetto)
+class Tracer
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	//!< Records [construction, destruction) as a complete event
+	class Scope
+	{
+	public:
+		Scope(Tracer& T, const char* N) : Owner(T), Name(N), Begin(Clock::now()) {}
+		~Scope() { Owner.Add(Name, Begin, Clock::now()); }
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	private:
+		Tracer& Owner;
+		const char* Name;
+		Clock::time_point Begin;
+	};
+
+	Tracer() : Origin(Clock::now()) {}
+
+	//!< Name must outlive the tracer (string literals)
+	void Add(const char* Name, const Clock::time_point Begin, const Clock::time_point End) {
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Events.push_back({ Name, ToUS(Begin), ToUS(End) - ToUS(Begin), GetThreadIndex(), 'X' });
+	}
+	void Instant(const char* Name) {
+		const auto Now = Clock::now();
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Events.push_back({ Name, ToUS(Now), 0, GetThreadIndex(), 'i' });
+	}
+	double GetElapsedMS() const { return std::chrono::duration<double, std::milli>(Clock::now() - Origin).count(); }
+
+	bool Write(const std::string& Path) const {
+		std::ofstream Out(Path.c_str());
+		if (Out.fail()) { return false; }
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Out << "{ \"traceEvents\" : [" << std::endl;
+		for (size_t i = 0; i < Events.size(); ++i) {
+			const auto& E = Events[i];
+			Out << "\t{ \"name\" : \"" << E.Name << "\", \"ph\" : \"" << E.Phase << "\", \"ts\" : " << E.Begin;
+			if ('X' == E.Phase) { Out << ", \"dur\" : " << E.Duration; } else { Out << ", \"s\" : \"g\""; }
+			Out << ", \"pid\" : 1, \"tid\" : " << E.Thread << " }" << (i + 1 < Events.size() ? "," : "") << std::endl;
+		}
+		Out << "], \"displayTimeUnit\" : \"ms\" }" << std::endl;
+		return !Out.fail();
+	}
+	//!< Phases in start order with their durations
+	void Print(std::ostream& Out) const {
+		std::lock_guard<std::mutex> Lock(Mutex);
+		auto Sorted = Events;
+		std::sort(Sorted.begin(), Sorted.end(), [](const Event& lhs, const Event& rhs) { return lhs.Begin < rhs.Begin; });
+		for (const auto& i : Sorted) {
+			Out << "\t[" << i.Thread << "] " << i.Name << " : " << i.Begin * 1.0e-3 << " msec";
+			if ('X' == i.Phase) { Out << " + " << i.Duration * 1.0e-3 << " msec"; }
+			Out << std::endl;
+		}
+	}
+
+private:
+	struct Event {
+		const char* Name;
+		uint64_t Begin;		//!< Microseconds from the tracer construction
+		uint64_t Duration;
+		uint32_t Thread;
+		char Phase;
+	};
+
+	uint64_t ToUS(const Clock::time_point TP) const { return std::chrono::duration_cast<std::chrono::microseconds>(TP - Origin).count(); }
+	//!< Small stable ids read better than hashed std::thread::id, Mutex must be held
+	uint32_t GetThreadIndex() {
+		const auto ID = std::this_thread::get_id();
+		const auto It = std::find(Threads.cbegin(), Threads.cend(), ID);
+		if (Threads.cend() != It) { return static_cast<uint32_t>(std::distance(Threads.cbegin(), It)); }
+		Threads.push_back(ID);
+		return static_cast<uint32_t>(Threads.size() - 1);
+	}
+
+	Clock::time_point Origin;
+	mutable std::mutex Mutex;
+	std::vector<Event> Events;
+	std::vector<std::thread::id> Threads;
+};
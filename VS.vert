@@ -2,13 +2,34 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
 
+layout (constant_id = 0) const float Scale = 1.0f;
+//!< Instances are laid out on an InstanceGrid x InstanceGrid grid, 1 stacks every instance at the origin
+layout (constant_id = 2) const int InstanceGrid = 1;
+//!< Greater than 0 : grid rows recede from distance 1 (first row) to 1 + Depth (last row) with a perspective divide, mirrored by GetInstanceDistance() for LOD selection
+layout (constant_id = 3) const float Depth = 0.0f;
+//!< Greater than 1 : every InstanceGrid x InstanceGrid instances form a layer, layers recede instead of rows with the first layer farthest away (drawn back to front)
+layout (constant_id = 4) const int Layers = 1;
+
 layout (location = 0) in vec3 InPosition;
 layout (location = 1) in vec4 InColor;
+layout (location = 2) in vec2 InTexcoord;
 
 layout (location = 0) out vec4 OutColor;
+layout (location = 1) out vec2 OutTexcoord;
 
 void main()
 {
-	gl_Position = vec4(InPosition, 1.0f);
+	const float Grid = float(InstanceGrid);
+	const vec2 Cell = vec2(gl_InstanceIndex % InstanceGrid, (gl_InstanceIndex / InstanceGrid) % InstanceGrid);
+	const vec2 Offset = (Cell + 0.5f) / Grid * 2.0f - 1.0f;
+	const vec3 Position = InPosition * Scale / Grid + vec3(Offset, 0.0f);
+	if (Depth > 0.0f) {
+		const float Layer = float(gl_InstanceIndex / (InstanceGrid * InstanceGrid));
+		const float Distance = 1.0f + Depth * (Layers > 1 ? (float(Layers - 1) - Layer) / float(Layers - 1) : Cell.y / max(Grid - 1.0f, 1.0f));
+		gl_Position = vec4(Position.xy, (Distance - 1.0f) / Depth * Distance, Distance);
+	} else {
+		gl_Position = vec4(Position, 1.0f);
+	}
 	OutColor = InColor;
+	OutTexcoord = InTexcoord;
 }